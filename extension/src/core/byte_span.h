@@ -0,0 +1,67 @@
+#ifndef MIDI_BYTE_SPAN_H
+#define MIDI_BYTE_SPAN_H
+
+#include <cstdint>
+#include <cstring>
+
+/// @brief Read-only view over a contiguous block of bytes
+/// The span does not own or copy the data, the buffer it points into
+/// must outlive every span (and sub-span) created from it
+struct ByteSpan
+{
+    const uint8_t *data;
+    int64_t size;
+
+    ByteSpan() : data(nullptr), size(0) {}
+    ByteSpan(const uint8_t *p_data, int64_t p_size) : data(p_data), size(p_size) {}
+
+    /// @brief unchecked access to a single byte
+    /// @param index
+    /// @return
+    inline uint8_t operator[](int64_t index) const { return data[index]; }
+
+    /// @brief Gets a sub-span of this span, clamped to the bounds of the span
+    /// @param begin first byte of the sub-span
+    /// @param end one past the last byte of the sub-span, -1 for the end of the span
+    /// @return the sub-span, no data is copied
+    inline ByteSpan slice(int64_t begin, int64_t end = -1) const
+    {
+        if (end < 0 || end > size)
+            end = size;
+        if (begin < 0)
+            begin = 0;
+        if (begin > end)
+            begin = end;
+        return ByteSpan(data + begin, end - begin);
+    }
+
+    /// @brief Checks if the span starts with the given ascii tag (e.g. a chunk id)
+    /// @param tag
+    /// @return
+    inline bool starts_with(const char *tag) const
+    {
+        int64_t length = static_cast<int64_t>(strlen(tag));
+        return size >= length && memcmp(data, tag, length) == 0;
+    }
+
+    inline bool is_empty() const { return size <= 0; }
+
+    // unchecked big endian reads, midi stores every multi byte number in big endian
+
+    inline uint16_t read_u16_be(int64_t offset) const
+    {
+        return static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+    }
+
+    inline uint32_t read_u24_be(int64_t offset) const
+    {
+        return (static_cast<uint32_t>(data[offset]) << 16) | (data[offset + 1] << 8) | data[offset + 2];
+    }
+
+    inline uint32_t read_u32_be(int64_t offset) const
+    {
+        return (static_cast<uint32_t>(data[offset]) << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3];
+    }
+};
+
+#endif // MIDI_BYTE_SPAN_H
@@ -0,0 +1,114 @@
+#include "controller_decimator.h"
+
+#include <cstdlib>
+#include <vector>
+
+/// @brief Checks if a controller carries a continuous value that can be thinned
+/// switches (sustain, sostenuto...), data entry and (N)RPN selection and channel mode messages
+/// mean something on their own and are always kept
+/// @param controller
+/// @return
+bool ControllerDecimator::is_continuous_controller(uint8_t controller)
+{
+    if (controller >= 120)
+        return false;
+    if (controller >= 64 && controller <= 69)
+        return false;
+    if (controller == 6 || controller == 38 || (controller >= 96 && controller <= 101))
+        return false;
+    return true;
+}
+
+/// @brief Marks which events of a track to keep, every event that isn't a continuous
+/// controller or pitch bend is kept
+/// an event is kept when its value is more than the tolerance away from the last kept value and
+/// at least min_interval after it, a value dropped only for the interval that is then held for
+/// min_interval is kept too, and so is the last value of every stream so it ends on the right value
+/// @param events
+/// @param settings
+/// @param keep [out] one flag per event, 1 to keep it
+/// @return number of dropped events
+size_t ControllerDecimator::decimate(const TrackEvents &events, const Settings &settings, uint8_t *keep)
+{
+    // 16 channels * 128 controllers, then one pitch bend stream per channel
+    constexpr size_t NUM_STREAMS = 16 * 128 + 16;
+    constexpr int64_t NONE = -1;
+    std::vector<int64_t> last_kept(NUM_STREAMS, NONE);
+    std::vector<int64_t> pending(NUM_STREAMS, NONE);
+    std::vector<int32_t> last_value(NUM_STREAMS, 0);
+
+    const auto get_value = [&](size_t i)
+    {
+        return (events.statuses[i] >> 4) == 0xE ? static_cast<int32_t>(events.data1[i] | (events.data2[i] << 7)) : static_cast<int32_t>(events.data2[i]);
+    };
+
+    size_t dropped = 0;
+    for (size_t i = 0; i < events.count; i++)
+    {
+        keep[i] = 1;
+
+        const uint8_t status = events.statuses[i];
+        const uint8_t channel = status & 0x0F;
+        size_t stream;
+        int32_t tolerance;
+        if ((status >> 4) == 0xB && is_continuous_controller(events.data1[i]))
+        {
+            stream = channel * 128 + events.data1[i];
+            tolerance = settings.controller_tolerance;
+        }
+        else if ((status >> 4) == 0xE)
+        {
+            stream = 16 * 128 + channel;
+            tolerance = settings.pitch_bend_tolerance;
+        }
+        else
+        {
+            continue;
+        }
+
+        const int32_t value = get_value(i);
+        if (last_kept[stream] == NONE)
+        {
+            last_kept[stream] = static_cast<int64_t>(i);
+            last_value[stream] = value;
+            continue;
+        }
+
+        // the value before this one was only dropped for coming too soon, but then stayed long enough to be heard
+        const int64_t held = pending[stream];
+        if (held != NONE && std::abs(get_value(held) - last_value[stream]) > tolerance && events.times[i] - events.times[held] >= settings.min_interval)
+        {
+            keep[held] = 1;
+            dropped--;
+            last_kept[stream] = held;
+            last_value[stream] = get_value(held);
+        }
+        pending[stream] = NONE;
+
+        if (value != last_value[stream] && std::abs(value - last_value[stream]) > tolerance && events.times[i] - events.times[last_kept[stream]] >= settings.min_interval)
+        {
+            last_kept[stream] = static_cast<int64_t>(i);
+            last_value[stream] = value;
+            continue;
+        }
+
+        keep[i] = 0;
+        dropped++;
+        // a repeat of the kept value has nothing to restore later
+        if (value != last_value[stream])
+            pending[stream] = static_cast<int64_t>(i);
+    }
+
+    // streams that end on a dropped value
+    for (size_t stream = 0; stream < NUM_STREAMS; stream++)
+    {
+        const int64_t held = pending[stream];
+        if (held != NONE)
+        {
+            keep[held] = 1;
+            dropped--;
+        }
+    }
+
+    return dropped;
+}
@@ -0,0 +1,40 @@
+#ifndef MIDI_CONTROLLER_DECIMATOR_H
+#define MIDI_CONTROLLER_DECIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Thins out dense controller and pitch bend streams
+/// Every channel/controller pair and every channel's pitch bend is a separate stream. Receivers hold
+/// a value until the next one arrives, so a dropped event is measured against the last kept value
+/// of its stream rather than against a line between its neighbours
+class ControllerDecimator
+{
+public:
+    struct Settings
+    {
+        // largest difference from the last kept value that may be dropped, 0 only drops repeated values
+        int32_t controller_tolerance = 0;
+        // the same for pitch bend, in 14 bit units (0 - 16383)
+        int32_t pitch_bend_tolerance = 0;
+        // smallest time between two kept events of a stream, in the units of the times passed in
+        double min_interval = 0.0;
+    };
+
+    /// @brief The events of one track, one array per field like the packed columns
+    struct TrackEvents
+    {
+        const uint8_t *statuses;
+        const uint8_t *data1;
+        const uint8_t *data2;
+        // absolute time of every event, ascending
+        const double *times;
+        size_t count;
+    };
+
+    static bool is_continuous_controller(uint8_t controller);
+
+    static size_t decimate(const TrackEvents &events, const Settings &settings, uint8_t *keep);
+};
+
+#endif // MIDI_CONTROLLER_DECIMATOR_H
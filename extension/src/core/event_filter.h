@@ -0,0 +1,87 @@
+#ifndef MIDI_EVENT_FILTER_H
+#define MIDI_EVENT_FILTER_H
+
+#include <cstdint>
+
+#include "midi_decoder.h"
+
+/// @brief Decides which decoded events of a track are kept
+/// Applied by MidiTrack while decoding, so dropped events never reach the event store.
+/// Tempo changes and end of track events are always kept, timing and track lengths
+/// stay the same no matter what is dropped
+class EventFilter
+{
+public:
+    enum Category : uint16_t
+    {
+        // note on and note off
+        Notes = 1 << 0,
+        // control change, includes the channel mode messages
+        Controllers = 1 << 1,
+        PitchBend = 1 << 2,
+        // polyphonic key pressure and channel pressure
+        Aftertouch = 1 << 3,
+        ProgramChange = 1 << 4,
+        Meta = 1 << 5,
+        // system common and system real time messages
+        System = 1 << 6,
+        SysEx = 1 << 7,
+        AllCategories = 0xFF
+    };
+
+    /// @brief Meta type of SetTempo, see MidiParser::MidiEventMeta
+    static constexpr uint8_t META_SET_TEMPO = 0x51;
+
+    // categories to keep, see Category
+    uint16_t categories = AllCategories;
+    // one bit per channel to keep, only applies to channel messages
+    uint16_t channels = 0xFFFF;
+
+    /// @brief Gets whether every event passes
+    /// @return
+    inline bool keeps_everything() const { return categories == AllCategories && channels == 0xFFFF; }
+
+    /// @brief Gets whether an event should be kept
+    /// @param event a decoded event, unknown events aren't filtered
+    /// @return
+    inline bool accepts(const MidiDecoder::Event &event) const
+    {
+        switch (event.kind)
+        {
+        case MidiDecoder::EventKind::Channel:
+        {
+            if (((channels >> (event.status & 0x0F)) & 1) == 0)
+                return false;
+
+            switch (event.status >> 4)
+            {
+            case 0x8:
+            case 0x9:
+                return (categories & Notes) != 0;
+            case 0xA:
+            case 0xD:
+                return (categories & Aftertouch) != 0;
+            case 0xB:
+                return (categories & Controllers) != 0;
+            case 0xC:
+                return (categories & ProgramChange) != 0;
+            default:
+                return (categories & PitchBend) != 0;
+            }
+        }
+        case MidiDecoder::EventKind::Meta:
+            // the tempo map and the end of every track depend on these
+            if (event.meta_type == META_SET_TEMPO || event.meta_type == MidiDecoder::META_END_OF_TRACK)
+                return true;
+            return (categories & Meta) != 0;
+        case MidiDecoder::EventKind::System:
+            return (categories & System) != 0;
+        case MidiDecoder::EventKind::SysEx:
+            return (categories & SysEx) != 0;
+        default:
+            return true;
+        }
+    }
+};
+
+#endif // MIDI_EVENT_FILTER_H
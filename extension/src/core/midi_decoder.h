@@ -0,0 +1,369 @@
+#ifndef MIDI_DECODER_H
+#define MIDI_DECODER_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "byte_span.h"
+
+// the decoder is called once per event, make sure it ends up inside of the track loop
+#if defined(_MSC_VER)
+#define MIDI_DECODER_INLINE __forceinline
+#else
+#define MIDI_DECODER_INLINE inline __attribute__((always_inline))
+#endif
+
+/// @brief Decoder for the event stream inside of an MTrk chunk
+/// Handles running status, SysEx packets and meta events in a single loop,
+/// callers receive plain Event structs and decide what to keep
+class MidiDecoder
+{
+public:
+    enum EventKind : uint8_t
+    {
+        Channel,
+        System,
+        Meta,
+        SysEx,
+        Unknown
+    };
+
+    enum Result
+    {
+        Ok,
+        EndOfData,
+        Truncated,
+        Invalid
+    };
+
+    struct StatusInfo
+    {
+        uint8_t data_length;
+        EventKind kind;
+    };
+
+    /// @brief status byte low nibble -> number of data bytes and event kind, for 0xF0 - 0xFF
+    static constexpr StatusInfo system_table[16] = {
+        {0, SysEx},   // 0xF0 system exclusive, length prefixed
+        {1, System},  // 0xF1 time code quarter frame
+        {2, System},  // 0xF2 song position pointer
+        {1, System},  // 0xF3 song select
+        {0, Unknown}, // 0xF4 undefined
+        {0, Unknown}, // 0xF5 undefined
+        {0, System},  // 0xF6 tune request
+        {0, SysEx},   // 0xF7 sysex continuation / escape, length prefixed
+        {0, System},  // 0xF8 timing clock
+        {0, System},  // 0xF9 undefined
+        {0, System},  // 0xFA start
+        {0, System},  // 0xFB continue
+        {0, System},  // 0xFC stop
+        {0, System},  // 0xFD undefined
+        {0, System},  // 0xFE active sensing
+        {0, Meta},    // 0xFF meta event
+    };
+
+    static constexpr uint8_t META_END_OF_TRACK = 0x2F;
+
+    /// @brief A single decoded event, payload offsets are relative to the start of the track data
+    struct Event
+    {
+        uint32_t delta;
+        uint8_t status;
+        uint8_t data1;
+        uint8_t data2;
+        uint8_t meta_type;
+        EventKind kind;
+        // offset of the status byte (or first data byte under running status)
+        int64_t offset;
+        // meta and sysex payload
+        int64_t payload_offset;
+        uint32_t payload_length;
+    };
+
+    /// @brief Decoder state carried from one event to the next
+    struct State
+    {
+        uint8_t running_status = 0;
+    };
+
+    /// @brief Number of data bytes of a channel message, passed to the channel handler of dispatch_status
+    template <uint8_t Length>
+    using DataLength = std::integral_constant<uint8_t, Length>;
+
+    /// @brief The one place that knows how many data bytes each status byte has
+    /// the decoder and get_status_info both dispatch through this switch, so they can't disagree
+    /// @param status a status byte
+    /// @param on_channel called as on_channel(DataLength<n>()) for channel messages (0x80 - 0xEF)
+    /// @param on_other called as on_other() for everything else, look those up in system_table
+    /// @return whatever the handler returns
+    template <typename OnChannel, typename OnOther>
+    static constexpr MIDI_DECODER_INLINE auto dispatch_status(uint8_t status, OnChannel &&on_channel, OnOther &&on_other)
+    {
+        switch (status >> 4)
+        {
+        case 0x8: // note off
+        case 0x9: // note on
+        case 0xA: // aftertouch
+        case 0xB: // controller
+        case 0xE: // pitch bend
+            return on_channel(DataLength<2>());
+        case 0xC: // program change
+        case 0xD: // channel pressure
+            return on_channel(DataLength<1>());
+        default:
+            return on_other();
+        }
+    }
+
+    /// @brief Gets the number of data bytes and the event kind of a status byte
+    /// @param status
+    /// @return
+    static constexpr StatusInfo get_status_info(uint8_t status)
+    {
+        return dispatch_status(
+            status, [](auto length)
+            { return StatusInfo{decltype(length)::value, Channel}; },
+            [status]()
+            {
+                // 0x00 - 0x7F are data bytes, they are only valid under running status
+                return status >= 0xF0 ? system_table[status & 0x0F] : StatusInfo{0, Unknown};
+            });
+    }
+
+    /// @brief Reads a variable length quantity, at most 4 bytes as per the midi specification
+    /// @param bytes
+    /// @param offset [in,out] advanced past the quantity on success
+    /// @param value [out]
+    /// @return false if the quantity runs past the end of the data or is longer than 4 bytes
+    static inline bool read_vlq(const ByteSpan &bytes, int64_t &offset, uint32_t &value)
+    {
+        value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (offset >= bytes.size)
+                return false;
+
+            uint8_t byte = bytes[offset++];
+            value = (value << 7) | (byte & 0x7F);
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    /// @brief Decodes the event at offset
+    /// @param track the track data (contents of the MTrk chunk)
+    /// @param offset [in,out] the offset of the event's delta time, advanced past the event on success
+    /// @param state the running status state
+    /// @param event [out] the decoded event
+    /// @return Ok if an event was decoded, EndOfData if offset is at the end of the track
+    static MIDI_DECODER_INLINE Result decode_event(const ByteSpan &track, int64_t &offset, State &state, Event &event)
+    {
+        // work on locals, event and state are byte sized fields that the
+        // compiler would otherwise have to assume alias the track data
+        const uint8_t *data = track.data;
+        const int64_t size = track.size;
+        int64_t cursor = offset;
+        if (cursor >= size)
+            return EndOfData;
+
+        uint32_t delta = data[cursor];
+        if (delta < 0x80)
+        {
+            // most delta times fit in a single byte
+            cursor++;
+        }
+        else if (cursor + 1 < size && data[cursor + 1] < 0x80)
+        {
+            // and nearly all of the rest in two
+            delta = ((delta & 0x7F) << 7) | data[cursor + 1];
+            cursor += 2;
+        }
+        else if (!read_vlq(track, cursor, delta))
+        {
+            return cursor >= size ? Truncated : Invalid;
+        }
+        if (cursor >= size)
+            return Truncated;
+
+        const int64_t event_offset = cursor;
+        uint8_t status = data[cursor];
+        uint8_t running_status = state.running_status;
+        if (status & 0x80)
+        {
+            cursor++;
+        }
+        else if (running_status != 0)
+        {
+            // running status, the byte we just looked at is the first data byte
+            status = running_status;
+        }
+        else
+        {
+            // a data byte without a status to go with it, skip it
+            event = {delta, status, 0, 0, 0, Unknown, event_offset, 0, 0};
+            offset = cursor + 1;
+            return Ok;
+        }
+
+        EventKind kind = Channel;
+        uint8_t data1 = 0;
+        uint8_t data2 = 0;
+        uint8_t meta_type = 0;
+        int64_t payload_offset = 0;
+        uint32_t payload_length = 0;
+        bool data_fits = true;
+
+        // every channel message with the same length takes the same branch,
+        // the cursor then advances by a constant
+        const bool is_channel = dispatch_status(
+            status,
+            [&](auto length)
+            {
+                constexpr uint8_t data_length = decltype(length)::value;
+                data_fits = cursor + data_length <= size;
+                if (data_fits)
+                {
+                    data1 = data[cursor];
+                    if (data_length == 2)
+                        data2 = data[cursor + 1];
+                    cursor += data_length;
+                }
+                return true;
+            },
+            []()
+            { return false; });
+        if (is_channel)
+        {
+            if (!data_fits)
+                return Truncated;
+            running_status = status;
+        }
+        else
+        {
+            const StatusInfo info = system_table[status & 0x0F];
+            kind = info.kind;
+            switch (kind)
+            {
+            case System:
+            {
+                if (cursor + info.data_length > size)
+                    return Truncated;
+                if (info.data_length == 2)
+                    data2 = data[cursor + 1];
+                if (info.data_length >= 1)
+                    data1 = data[cursor];
+                cursor += info.data_length;
+
+                // system common messages clear running status, real time messages (0xF8 and up) leave it alone
+                if (status < 0xF8)
+                    running_status = 0;
+                break;
+            }
+            case Meta:
+            case SysEx:
+            {
+                if (kind == Meta)
+                {
+                    if (cursor >= size)
+                        return Truncated;
+                    meta_type = data[cursor++];
+                }
+
+                if (!read_vlq(track, cursor, payload_length))
+                    return cursor >= size ? Truncated : Invalid;
+                if (cursor + payload_length > size)
+                    return Truncated;
+
+                payload_offset = cursor;
+                cursor += payload_length;
+
+                // meta and sysex events cancel running status
+                running_status = 0;
+                break;
+            }
+            default:
+            {
+                // undefined status byte, only the status byte itself is skipped
+                running_status = 0;
+                break;
+            }
+            }
+        }
+
+        event = {delta, status, data1, data2, meta_type, kind, event_offset, payload_offset, payload_length};
+        state.running_status = running_status;
+        offset = cursor;
+        return Ok;
+    }
+
+    /// @brief Outcome of decoding a whole track
+    struct Validation
+    {
+        Result result;
+        // end of the last event that fits inside of the track, the damaged tail starts here
+        int64_t end_offset;
+        size_t num_events;
+        bool end_of_track;
+    };
+
+    /// @brief Decodes every event in a track, stopping after the end of track meta event
+    /// @param track the track data (contents of the MTrk chunk)
+    /// @param sink called with each event as `bool sink(const Event &)`, return false to stop early
+    /// @return Ok if the whole track was decoded
+    template <typename Sink>
+    static inline Result decode_track(const ByteSpan &track, Sink &&sink)
+    {
+        return decode_checked(track, sink).result;
+    }
+
+    /// @brief Decodes every event of a track in one checked pass, stopping at the first damaged event
+    /// validation happens on the way, the sink only ever sees events that fit inside of the track
+    /// @param track the track data (contents of the MTrk chunk)
+    /// @param sink called with each event as `bool sink(const Event &)`, return false to stop early
+    /// @return Ok if the whole track is well formed, otherwise the error and where it happened
+    template <typename Sink>
+    static inline Validation decode_checked(const ByteSpan &track, Sink &&sink)
+    {
+        // a local copy, otherwise every write of the sink forces a reload of the bounds
+        const ByteSpan bytes = track;
+        Validation validation = {Ok, 0, 0, false};
+        State state;
+        Event event;
+        int64_t offset = 0;
+        while (true)
+        {
+            Result result = decode_event(bytes, offset, state, event);
+            if (result == EndOfData)
+                break;
+            if (result != Ok)
+            {
+                validation.result = result;
+                break;
+            }
+
+            validation.num_events++;
+            if (!sink(event))
+                break;
+
+            if (event.kind == Meta && event.meta_type == META_END_OF_TRACK)
+            {
+                validation.end_of_track = true;
+                break;
+            }
+        }
+        validation.end_offset = offset;
+        return validation;
+    }
+
+    /// @brief Checks that every event of a track fits inside of the track, without keeping any of them
+    /// @param track the track data (contents of the MTrk chunk)
+    /// @return Ok if the whole track is well formed, otherwise the error and where it happened
+    static inline Validation validate_track(const ByteSpan &track)
+    {
+        return decode_checked(track, [](const Event &)
+                              { return true; });
+    }
+};
+
+#endif // MIDI_DECODER_H
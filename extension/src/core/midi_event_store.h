@@ -0,0 +1,159 @@
+#ifndef MIDI_EVENT_STORE_H
+#define MIDI_EVENT_STORE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "byte_span.h"
+#include "midi_decoder.h"
+#include "parse_arena.h"
+
+/// @brief Struct of arrays storage for the events of a single track
+/// Every event is stored exactly once as a row across the columns below,
+/// meta and sysex payloads stay in the track data and are referenced by offset
+class MidiEventStore
+{
+public:
+    template <typename T>
+    using Column = std::vector<T, ArenaAllocator<T>>;
+
+    /// @brief bytes used by one row across all columns
+    static constexpr size_t ROW_SIZE = sizeof(uint32_t) * 3 + sizeof(uint8_t) * 3;
+
+    /// @brief delta time in ticks since the previous event
+    Column<uint32_t> deltas;
+    /// @brief status byte, 0xFF for meta events
+    Column<uint8_t> statuses;
+    /// @brief first data byte (note, controller, program...), the type for meta events
+    Column<uint8_t> data1;
+    /// @brief second data byte (velocity, value...)
+    Column<uint8_t> data2;
+    /// @brief meta/sysex payload location inside of the track data
+    Column<uint32_t> payload_offsets;
+    Column<uint32_t> payload_lengths;
+
+    /// @brief Creates an empty store
+    /// @param arena where the columns get their memory from, nullptr to use the heap
+    explicit MidiEventStore(ParseArena *arena = nullptr)
+        : deltas(ArenaAllocator<uint32_t>(arena)),
+          statuses(ArenaAllocator<uint8_t>(arena)),
+          data1(ArenaAllocator<uint8_t>(arena)),
+          data2(ArenaAllocator<uint8_t>(arena)),
+          payload_offsets(ArenaAllocator<uint32_t>(arena)),
+          payload_lengths(ArenaAllocator<uint32_t>(arena))
+    {
+    }
+
+    /// @brief typed view of a channel message
+    class NoteView
+    {
+    public:
+        NoteView(const MidiEventStore &store, size_t index) : store(store), index(index) {}
+
+        inline uint32_t get_delta() const { return store.deltas[index]; }
+        inline uint8_t get_type() const { return store.statuses[index] >> 4; }
+        inline uint8_t get_channel() const { return store.statuses[index] & 0x0F; }
+        inline uint8_t get_note() const { return store.data1[index]; }
+        inline uint8_t get_data() const { return store.data2[index]; }
+
+    private:
+        const MidiEventStore &store;
+        size_t index;
+    };
+
+    /// @brief typed view of a meta event
+    class MetaView
+    {
+    public:
+        MetaView(const MidiEventStore &store, size_t index) : store(store), index(index) {}
+
+        inline uint32_t get_delta() const { return store.deltas[index]; }
+        inline uint8_t get_type() const { return store.data1[index]; }
+
+        /// @brief Gets the payload of the event
+        /// @param track_data the track data the store was decoded from
+        /// @return
+        inline ByteSpan get_payload(const ByteSpan &track_data) const
+        {
+            int64_t offset = store.payload_offsets[index];
+            return track_data.slice(offset, offset + store.payload_lengths[index]);
+        }
+
+    private:
+        const MidiEventStore &store;
+        size_t index;
+    };
+
+    /// @brief typed view of a system common/real time message
+    class SystemView
+    {
+    public:
+        SystemView(const MidiEventStore &store, size_t index) : store(store), index(index) {}
+
+        inline uint32_t get_delta() const { return store.deltas[index]; }
+        inline uint8_t get_type() const { return store.statuses[index]; }
+
+    private:
+        const MidiEventStore &store;
+        size_t index;
+    };
+
+    inline size_t size() const { return statuses.size(); }
+
+    inline void reserve(size_t capacity)
+    {
+        deltas.reserve(capacity);
+        statuses.reserve(capacity);
+        data1.reserve(capacity);
+        data2.reserve(capacity);
+        payload_offsets.reserve(capacity);
+        payload_lengths.reserve(capacity);
+    }
+
+    inline void clear()
+    {
+        deltas.clear();
+        statuses.clear();
+        data1.clear();
+        data2.clear();
+        payload_offsets.clear();
+        payload_lengths.clear();
+    }
+
+    /// @brief Appends a decoded event, meta events store their type in data1
+    /// @param event
+    inline void push_back(const MidiDecoder::Event &event)
+    {
+        deltas.push_back(event.delta);
+        statuses.push_back(event.status);
+        data1.push_back(event.kind == MidiDecoder::EventKind::Meta ? event.meta_type : event.data1);
+        data2.push_back(event.data2);
+        payload_offsets.push_back(static_cast<uint32_t>(event.payload_offset));
+        payload_lengths.push_back(event.payload_length);
+    }
+
+    /// @brief Gets the kind of event stored at index
+    /// @param index
+    /// @return
+    inline MidiDecoder::EventKind get_kind(size_t index) const
+    {
+        return MidiDecoder::get_status_info(statuses[index]).kind;
+    }
+
+    /// @brief Rebuilds the decoded event stored at index, the source offset isn't kept
+    /// @param index
+    /// @return
+    inline MidiDecoder::Event get_event(size_t index) const
+    {
+        const uint8_t status = statuses[index];
+        const MidiDecoder::EventKind kind = MidiDecoder::get_status_info(status).kind;
+        const bool is_meta = kind == MidiDecoder::EventKind::Meta;
+        return {deltas[index], status, is_meta ? static_cast<uint8_t>(0) : data1[index], data2[index], is_meta ? data1[index] : static_cast<uint8_t>(0), kind, 0, payload_offsets[index], payload_lengths[index]};
+    }
+
+    inline NoteView get_note(size_t index) const { return NoteView(*this, index); }
+    inline MetaView get_meta(size_t index) const { return MetaView(*this, index); }
+    inline SystemView get_system(size_t index) const { return SystemView(*this, index); }
+};
+
+#endif // MIDI_EVENT_STORE_H
@@ -0,0 +1,91 @@
+#include "midi_file.h"
+
+#include <cstring>
+
+/// @brief Reads the chunk at the start of bytes
+/// @param bytes the remaining file data
+/// @param chunk [out] the chunk, a truncated chunk only gets the bytes that are actually there
+/// @return a view of bytes minus the chunk, nothing is copied
+ByteSpan MidiFile::read_chunk(const ByteSpan &bytes, Chunk &chunk)
+{
+    chunk = Chunk();
+    if (bytes.size < 8)
+    {
+        // not enough data left for a chunk header
+        return bytes.slice(bytes.size);
+    }
+
+    memcpy(chunk.id, bytes.data, 4);
+    chunk.data = bytes.slice(8, 8 + static_cast<int64_t>(bytes.read_u32_be(4)));
+    chunk.size = static_cast<uint32_t>(chunk.data.size);
+
+    if (bytes.starts_with("MThd"))
+    {
+        chunk.type = ChunkType::Header;
+    }
+    else if (bytes.starts_with("MTrk"))
+    {
+        chunk.type = ChunkType::Track;
+    }
+    else
+    {
+        // unknown chunks are ignored per the midi specification
+        chunk.type = ChunkType::Unknown;
+    }
+
+    return bytes.slice(8 + static_cast<int64_t>(chunk.size));
+}
+
+/// @brief Reads the length field of the chunk header at the start of bytes, for parsers that
+/// get the file in parts and can't wait for the whole chunk like read_chunk does
+/// @param bytes at least the 8 bytes of the chunk header
+/// @param size [out] the length of the chunk data, without the header
+/// @return false if the header is incomplete or the length is larger than MAX_CHUNK_SIZE
+bool MidiFile::read_chunk_size(const ByteSpan &bytes, int64_t &size)
+{
+    size = 0;
+    if (bytes.size < 8)
+        return false;
+
+    // the field is unsigned 32 bit, it must not be read as int32_t
+    const int64_t length = static_cast<int64_t>(bytes.read_u32_be(4));
+    if (length > MAX_CHUNK_SIZE)
+        return false;
+
+    size = length;
+    return true;
+}
+
+/// @brief Reads the contents of an MThd chunk
+/// @param chunk
+/// @param header [out]
+/// @return false if the chunk isn't a valid header chunk
+bool MidiFile::read_header(const Chunk &chunk, FileHeader &header)
+{
+    if (chunk.type != ChunkType::Header || chunk.size < 6)
+        return false;
+
+    // data section of a header contains 3 16-bit words
+    // first word is format
+    // 0 - single track, 1 - multiple tracks, 2 - multiple songs
+    header.format = chunk.data.read_u16_be(0);
+
+    // second word is number of tracks
+    header.num_tracks = chunk.data.read_u16_be(2);
+
+    // third word is time division
+    // if bit 15 is 0, then it's ticks per quarter note
+    // if bit 15 is 1, then it's SMPTE format (negative frames per second + ticks per frame)
+    header.division_type = (DivisionType)((chunk.data[4] >> 7) & 0x01);
+
+    if (header.division_type == DivisionType::TicksPerQuarterNote)
+    {
+        header.division = chunk.data.read_u16_be(4);
+    }
+    else
+    {
+        // TODO: implement SMPTE format
+    }
+
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef MIDI_FILE_H
+#define MIDI_FILE_H
+
+#include <cstdint>
+
+#include "byte_span.h"
+
+/// @brief Chunk level layout of a standard midi file
+/// Splits a file into its chunks and reads the MThd header, everything is a view into the file
+class MidiFile
+{
+public:
+    enum ChunkType
+    {
+        Header,
+        Track,
+        Unknown
+    };
+
+    struct Chunk
+    {
+        // four character chunk id, not null terminated
+        char id[4] = {0, 0, 0, 0};
+        uint32_t size = 0;
+        ByteSpan data;
+        ChunkType type = ChunkType::Unknown;
+    };
+
+    enum DivisionType
+    {
+        TicksPerQuarterNote = 0,
+        FramesPerSecond = 1
+    };
+
+    struct FileHeader
+    {
+        int32_t format = 0;
+        int32_t num_tracks = 0;
+        DivisionType division_type = DivisionType::TicksPerQuarterNote;
+        int32_t division = 48;
+    };
+
+    /// @brief Largest chunk length read_chunk_size accepts, far beyond any real midi file
+    /// a longer length is treated as corrupt data instead of waiting for gigabytes that never come
+    static constexpr int64_t MAX_CHUNK_SIZE = int64_t(1) << 28;
+
+    static ByteSpan read_chunk(const ByteSpan &bytes, Chunk &chunk);
+    static bool read_chunk_size(const ByteSpan &bytes, int64_t &size);
+    static bool read_header(const Chunk &chunk, FileHeader &header);
+};
+
+#endif // MIDI_FILE_H
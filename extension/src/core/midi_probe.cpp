@@ -0,0 +1,204 @@
+#include "midi_probe.h"
+
+#include <algorithm>
+
+#include "midi_decoder.h"
+
+// skip_table entries that aren't a number of data bytes
+// meta and sysex events, a length prefixed payload follows
+static constexpr uint8_t SKIP_PAYLOAD = 0x80;
+// undefined status bytes, only the status byte itself is skipped
+static constexpr uint8_t SKIP_STATUS = 0x40;
+
+struct SkipTable
+{
+    uint8_t skip[256];
+};
+
+/// @brief Builds the status byte -> bytes to skip table from MidiDecoder::get_status_info,
+/// so the probe can't disagree with the decoder about the length of an event
+static constexpr SkipTable make_skip_table()
+{
+    SkipTable table = {};
+    for (int status = 0; status < 256; status++)
+    {
+        const MidiDecoder::StatusInfo info = MidiDecoder::get_status_info(static_cast<uint8_t>(status));
+        switch (info.kind)
+        {
+        case MidiDecoder::EventKind::Channel:
+        case MidiDecoder::EventKind::System:
+            table.skip[status] = info.data_length;
+            break;
+        case MidiDecoder::EventKind::Meta:
+        case MidiDecoder::EventKind::SysEx:
+            table.skip[status] = SKIP_PAYLOAD;
+            break;
+        default:
+            table.skip[status] = SKIP_STATUS;
+            break;
+        }
+    }
+    return table;
+}
+
+static constexpr SkipTable skip_table = make_skip_table();
+
+/// @brief Walks the events of a track without decoding them, only note ons and the
+/// track name and tempo meta events are looked at, everything else is skipped by its length
+/// follows MidiDecoder::decode_checked: stops after the end of track event or before the first damaged one
+/// @param track the contents of the MTrk chunk
+/// @param summary [in,out] note_count and tempo_changes are added to
+/// @param track_name [out] the payload of the last track name event
+/// @return the tick of the last event
+static int64_t skip_track(const ByteSpan &track, MidiProbe::Summary &summary, ByteSpan &track_name)
+{
+    const uint8_t *data = track.data;
+    const int64_t size = track.size;
+    int64_t cursor = 0;
+    int64_t tick = 0;
+    // a local, a count in the summary would be reloaded after every read of the track bytes
+    int64_t note_count = 0;
+    uint8_t running_status = 0;
+    while (cursor < size)
+    {
+        // one and two byte delta times first, like the decoder
+        uint32_t delta = data[cursor];
+        if (delta < 0x80)
+        {
+            cursor++;
+        }
+        else if (cursor + 1 < size && data[cursor + 1] < 0x80)
+        {
+            delta = ((delta & 0x7F) << 7) | data[cursor + 1];
+            cursor += 2;
+        }
+        else if (!MidiDecoder::read_vlq(track, cursor, delta))
+        {
+            break;
+        }
+        if (cursor >= size)
+            break;
+
+        uint8_t status = data[cursor];
+        if (status & 0x80)
+        {
+            cursor++;
+        }
+        else if (running_status != 0)
+        {
+            status = running_status;
+        }
+        else
+        {
+            // a data byte without a status to go with it, the decoder skips it too
+            tick += delta;
+            cursor++;
+            continue;
+        }
+
+        // note ons and offs are the bulk of a file, branching on them lets the cursor move
+        // by a constant instead of waiting for the table lookup
+        if ((status & 0xE0) == 0x80)
+        {
+            if (cursor + 2 > size)
+                break;
+
+            // a note on with zero velocity is a note off
+            if ((status & 0x10) && data[cursor + 1] > 0)
+                note_count++;
+            cursor += 2;
+        }
+        else
+        {
+            const uint8_t skip = skip_table.skip[status];
+            if (skip <= 2)
+            {
+                if (cursor + skip > size)
+                    break;
+                cursor += skip;
+            }
+            else if (skip == SKIP_PAYLOAD)
+            {
+                uint8_t meta_type = 0;
+                if (status == 0xFF)
+                {
+                    if (cursor >= size)
+                        break;
+                    meta_type = data[cursor++];
+                }
+
+                uint32_t length = 0;
+                if (!MidiDecoder::read_vlq(track, cursor, length) || cursor + length > size)
+                    break;
+
+                const ByteSpan payload = track.slice(cursor, cursor + length);
+                cursor += length;
+                if (status != 0xFF)
+                {
+                    // sysex, nothing to look at
+                }
+                else if (meta_type == MidiProbe::META_TRACK_NAME)
+                {
+                    track_name = payload;
+                }
+                else if (meta_type == MidiProbe::META_SET_TEMPO && payload.size >= 3)
+                {
+                    summary.tempo_changes.push_back({tick + delta, static_cast<int32_t>(payload.read_u24_be(0))});
+                }
+                else if (meta_type == MidiDecoder::META_END_OF_TRACK)
+                {
+                    tick += delta;
+                    break;
+                }
+            }
+        }
+        tick += delta;
+
+        // the same running status rules as the decoder: channel messages set it, real time messages
+        // (0xF8 - 0xFE) leave it alone, everything else clears it
+        if (status < 0xF0)
+            running_status = status;
+        else if (status < 0xF8 || status == 0xFF)
+            running_status = 0;
+    }
+
+    summary.note_count += note_count;
+    return tick;
+}
+
+/// @brief Reads the summary of a whole midi file held in memory
+/// a truncated file is summarized up to where it ends
+/// @param bytes the whole file, track names point into it
+/// @param summary [out]
+/// @return false if the file doesn't start with a valid MThd chunk
+bool MidiProbe::probe(const ByteSpan &bytes, Summary &summary)
+{
+    summary = Summary();
+
+    MidiFile::Chunk header_chunk;
+    ByteSpan remaining = MidiFile::read_chunk(bytes, header_chunk);
+    if (!MidiFile::read_header(header_chunk, summary.header))
+        return false;
+
+    const size_t num_tracks = static_cast<size_t>(summary.header.num_tracks);
+    while (!remaining.is_empty() && summary.track_names.size() < num_tracks)
+    {
+        MidiFile::Chunk chunk;
+        remaining = MidiFile::read_chunk(remaining, chunk);
+        if (chunk.type != MidiFile::ChunkType::Track)
+            continue;
+
+        ByteSpan track_name;
+        const int64_t length_ticks = skip_track(chunk.data, summary, track_name);
+
+        summary.track_names.push_back(track_name);
+        summary.length_ticks = std::max(summary.length_ticks, length_ticks);
+    }
+
+    // tempo changes can come from any track, the tempo map merges them in time order
+    summary.tempo_map.build(summary.header.division, DEFAULT_TEMPO, summary.tempo_changes);
+    std::stable_sort(summary.tempo_changes.begin(), summary.tempo_changes.end(), [](const TempoMap::Change &a, const TempoMap::Change &b)
+                     { return a.tick < b.tick; });
+    summary.duration = summary.tempo_map.tick_to_seconds(static_cast<double>(summary.length_ticks));
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef MIDI_PROBE_H
+#define MIDI_PROBE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "byte_span.h"
+#include "midi_file.h"
+#include "tempo_map.h"
+
+/// @brief Summary of a midi file read without building any events
+/// Skips through every MTrk chunk once by the length of each event, only counts notes and looks at the
+/// track name and tempo meta events
+class MidiProbe
+{
+public:
+    /// @brief tempo until the first SetTempo event, 120 bpm
+    static constexpr int32_t DEFAULT_TEMPO = 500000;
+
+    /// @brief Meta types the probe reads, see MidiParser::MidiEventMeta
+    static constexpr uint8_t META_TRACK_NAME = 0x03;
+    static constexpr uint8_t META_SET_TEMPO = 0x51;
+
+    struct Summary
+    {
+        MidiFile::FileHeader header;
+        // one entry per track that was found, the payload of its name meta
+        // event (a view into the file) or an empty span if it has none
+        std::vector<ByteSpan> track_names;
+        int64_t note_count = 0;
+        // the SetTempo events of every track in time order
+        std::vector<TempoMap::Change> tempo_changes;
+        TempoMap tempo_map;
+        int64_t length_ticks = 0;
+        double duration = 0.0;
+    };
+
+    static bool probe(const ByteSpan &bytes, Summary &summary);
+};
+
+#endif // MIDI_PROBE_H
@@ -0,0 +1,70 @@
+#ifndef MIDI_SCHEDULER_H
+#define MIDI_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Engine independent playback timing
+/// Walks the events of a track forward in time by comparing their absolute times (see TempoMap)
+/// against the playback position, the caller decides what firing an event means
+class MidiScheduler
+{
+public:
+    /// @brief Playback position inside of a single track
+    struct TrackCursor
+    {
+        // index of the next event that hasn't fired yet
+        size_t next_event = 0;
+    };
+
+    /// @brief Fires every event of a track that is due at song_time
+    /// @param cursor the track's position, advanced past the fired events
+    /// @param num_events number of events in the track
+    /// @param song_time playback position in seconds since the start of the song
+    /// @param get_event_time `double(size_t index)`, the absolute time of an event in seconds
+    /// @param fire `void(size_t index)`, called for each due event in order
+    /// @return whether the track still had more than one event left before this call
+    template <typename GetTime, typename Fire>
+    static inline bool advance(TrackCursor &cursor, size_t num_events, double song_time, GetTime &&get_event_time, Fire &&fire)
+    {
+        // the last event of a track (normally the end of track event) isn't waited for
+        const bool has_more_events = cursor.next_event + 1 < num_events;
+
+        // stop at the first event that is still in the future
+        while (cursor.next_event < num_events && get_event_time(cursor.next_event) <= song_time)
+        {
+            // start at the next event on the next call
+            const size_t index = cursor.next_event++;
+            fire(index);
+        }
+
+        return has_more_events;
+    }
+
+    /// @brief Moves a cursor to song_time without firing anything
+    /// a binary search, the event times of a track never decrease
+    /// @param cursor [out] positioned at the first event after song_time
+    /// @param num_events number of events in the track
+    /// @param song_time playback position in seconds since the start of the song
+    /// @param get_event_time `double(size_t index)`, the absolute time of an event in seconds
+    template <typename GetTime>
+    static inline void seek(TrackCursor &cursor, size_t num_events, double song_time, GetTime &&get_event_time)
+    {
+        // first event with a time after song_time, everything before it counts as fired
+        size_t lo = 0;
+        size_t hi = num_events;
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (get_event_time(mid) <= song_time)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        cursor = TrackCursor();
+        cursor.next_event = lo;
+    }
+};
+
+#endif // MIDI_SCHEDULER_H
@@ -0,0 +1,57 @@
+#include "midi_timeline.h"
+
+#include <functional>
+#include <queue>
+
+/// @brief k-way merge of the tracks by tick, events on the same tick keep track order
+/// and the order they have inside of their track
+/// @param tracks
+/// @param out_tracks [out] track index of every entry, room for the sum of all counts
+/// @param out_events [out] event index inside of its track of every entry, same size
+void MidiTimeline::merge(const std::vector<TrackTicks> &tracks, int32_t *out_tracks, int32_t *out_events)
+{
+    // (tick, track) of the head of every track that still has events
+    using Head = std::pair<int64_t, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    std::vector<size_t> next(tracks.size(), 0);
+
+    for (size_t track = 0; track < tracks.size(); track++)
+    {
+        if (tracks[track].count > 0)
+            heads.push({tracks[track].ticks[0], track});
+    }
+
+    size_t entry = 0;
+    while (!heads.empty())
+    {
+        const size_t track = heads.top().second;
+        heads.pop();
+
+        const size_t index = next[track]++;
+        out_tracks[entry] = static_cast<int32_t>(track);
+        out_events[entry] = static_cast<int32_t>(index);
+        entry++;
+
+        if (index + 1 < tracks[track].count)
+            heads.push({tracks[track].ticks[index + 1], track});
+    }
+}
+
+/// @brief Gets how many entries of a merged timeline have to fire before playback counts as finished
+/// the same rule as playing track by track (see MidiScheduler::advance): the last event of every
+/// track, normally its end of track event, isn't waited for
+/// @param tracks the tracks that were merged
+/// @param merged_tracks track index of every entry, from merge
+/// @param merged_events event index inside of its track of every entry, from merge
+/// @param count number of entries
+/// @return one past the last entry that isn't the last event of its track, 0 if there is none
+size_t MidiTimeline::finish_position(const std::vector<TrackTicks> &tracks, const int32_t *merged_tracks, const int32_t *merged_events, size_t count)
+{
+    for (size_t entry = count; entry > 0; entry--)
+    {
+        const size_t track_size = tracks[merged_tracks[entry - 1]].count;
+        if (static_cast<size_t>(merged_events[entry - 1]) + 1 < track_size)
+            return entry;
+    }
+    return 0;
+}
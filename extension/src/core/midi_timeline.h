@@ -0,0 +1,24 @@
+#ifndef MIDI_TIMELINE_H
+#define MIDI_TIMELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Merges the events of several tracks into one stream sorted by time
+/// Each entry refers back to its track and its index inside of that track
+class MidiTimeline
+{
+public:
+    /// @brief The ticks of one track, ascending
+    struct TrackTicks
+    {
+        const int32_t *ticks;
+        size_t count;
+    };
+
+    static void merge(const std::vector<TrackTicks> &tracks, int32_t *out_tracks, int32_t *out_events);
+    static size_t finish_position(const std::vector<TrackTicks> &tracks, const int32_t *merged_tracks, const int32_t *merged_events, size_t count);
+};
+
+#endif // MIDI_TIMELINE_H
@@ -0,0 +1,104 @@
+#include "midi_track.h"
+
+/// @brief Decodes the events of a track chunk, replacing whatever was decoded before
+/// damaged data is reported to the diagnostics, the events before the damage are kept
+/// and events rejected by filter are dropped
+/// @param track_data the contents of the MTrk chunk, must outlive the track
+void MidiTrack::decode(const ByteSpan &track_data)
+{
+    // the decoder walks the chunk and handles running status,
+    // we only decide what to do with each event
+    end_of_track = false;
+    data = track_data;
+    events.clear();
+    diagnostics.clear();
+
+    // every event takes at least two bytes (a delta time and a status or data byte), sizing the
+    // columns for that keeps every column of this track in one arena block without counting first
+    const size_t max_events = static_cast<size_t>(track_data.size / 2 + 1);
+    arena->reserve(max_events * MidiEventStore::ROW_SIZE + 6 * alignof(uint32_t));
+    events.reserve(max_events);
+
+    // the time of dropped events (filtered or unknown) is added to the next kept one, so the ticks don't shift
+    const bool filtered = !filter.keeps_everything();
+    uint32_t dropped_delta = 0;
+    const auto sink = [&](const MidiDecoder::Event &decoded)
+    {
+        if (decoded.kind == MidiDecoder::EventKind::Unknown)
+        {
+            // only the offending byte is skipped, details are left to the diagnostics summary
+            diagnostics.report(decoded.status & 0x80 ? ParseDiagnostics::UnknownEvent : ParseDiagnostics::StrayDataByte, decoded.offset, 1);
+            dropped_delta += decoded.delta;
+            return true;
+        }
+
+        if (filtered && !filter.accepts(decoded))
+        {
+            dropped_delta += decoded.delta;
+            return true;
+        }
+
+        MidiDecoder::Event event = decoded;
+        event.delta += dropped_delta;
+        dropped_delta = 0;
+
+        switch (event.kind)
+        {
+        case MidiDecoder::EventKind::Channel:
+        case MidiDecoder::EventKind::System:
+        {
+            events.push_back(event);
+            break;
+        }
+        case MidiDecoder::EventKind::Meta:
+        {
+            events.push_back(event);
+            if (event.meta_type == MidiDecoder::META_END_OF_TRACK)
+            {
+                end_of_track = true;
+            }
+            break;
+        }
+        case MidiDecoder::EventKind::SysEx:
+        {
+            // the payload stays in the track data, only its location is stored
+            events.push_back(event);
+            break;
+        }
+        case MidiDecoder::EventKind::Unknown:
+            break;
+        }
+        return true;
+    };
+
+    // a single checked pass, it stops at the damage and everything before it is kept
+    const MidiDecoder::Validation validation = MidiDecoder::decode_checked(track_data, sink);
+
+    report_damage(validation, track_data.size, diagnostics);
+}
+
+/// @brief Reports why decoding stopped before the end of a track, if it did
+/// @param validation the result of decode_checked or validate_track
+/// @param size size of the track data in bytes
+/// @param diagnostics [out] offsets are relative to the start of the track data
+void MidiTrack::report_damage(const MidiDecoder::Validation &validation, int64_t size, ParseDiagnostics &diagnostics)
+{
+    const int64_t end_offset = validation.end_offset;
+    const int64_t remaining = size - end_offset;
+    if (validation.result == MidiDecoder::Result::Truncated)
+    {
+        diagnostics.report(ParseDiagnostics::TruncatedTrack, end_offset, remaining);
+    }
+    else if (validation.result == MidiDecoder::Result::Invalid)
+    {
+        diagnostics.report(ParseDiagnostics::InvalidData, end_offset, remaining);
+    }
+    else if (!validation.end_of_track)
+    {
+        diagnostics.report(ParseDiagnostics::MissingEndOfTrack, end_offset);
+    }
+    else if (remaining > 0)
+    {
+        diagnostics.report(ParseDiagnostics::DataAfterEndOfTrack, end_offset, remaining);
+    }
+}
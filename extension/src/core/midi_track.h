@@ -0,0 +1,43 @@
+#ifndef MIDI_TRACK_H
+#define MIDI_TRACK_H
+
+#include <cstdint>
+#include <memory>
+
+#include "byte_span.h"
+#include "event_filter.h"
+#include "midi_decoder.h"
+#include "midi_event_store.h"
+#include "parse_arena.h"
+#include "parse_diagnostics.h"
+
+/// @brief The decoded events of a single MTrk chunk
+/// Tracks don't depend on each other, so several of them can be decoded at once
+class MidiTrack
+{
+public:
+    // owns all memory of the event columns, heap allocated so its
+    // address stays the same when the track is moved around
+    std::unique_ptr<ParseArena> arena;
+    // every event of the track, stored once in columns
+    MidiEventStore events;
+    // the chunk the events were decoded from, meta payloads point into it
+    ByteSpan data;
+
+    // set once the end of track meta event has been parsed
+    bool end_of_track;
+
+    // events it rejects are left out, set before calling decode
+    EventFilter filter;
+
+    // offsets are relative to the start of the track data
+    ParseDiagnostics diagnostics;
+
+    MidiTrack() : arena(std::make_unique<ParseArena>()), events(arena.get()), end_of_track(false) {}
+
+    void decode(const ByteSpan &track_data);
+
+    static void report_damage(const MidiDecoder::Validation &validation, int64_t size, ParseDiagnostics &diagnostics);
+};
+
+#endif // MIDI_TRACK_H
@@ -0,0 +1,148 @@
+#include "note_index.h"
+
+#include <algorithm>
+
+#include "midi_decoder.h"
+
+/// @brief Pairs the note on and note off events of a track into notes
+/// a note off closes the oldest open note of its channel and pitch, notes that are
+/// never closed end at the last event of the track
+/// @param events
+/// @param track index stored in every note
+/// @param notes [out] the notes are appended in the order they end
+void NoteIndex::pair_track(const TrackEvents &events, int32_t track, std::vector<Note> &notes)
+{
+    // open notes per channel and pitch, oldest first
+    std::vector<std::vector<Note>> open_notes(16 * 128);
+
+    for (size_t i = 0; i < events.count; i++)
+    {
+        const uint8_t status = events.statuses[i];
+        if (MidiDecoder::get_status_info(status).kind != MidiDecoder::EventKind::Channel)
+            continue;
+
+        const uint8_t type = status >> 4;
+        const uint8_t channel = status & 0x0F;
+        const uint8_t pitch = events.data1[i] & 0x7F;
+        std::vector<Note> &open = open_notes[channel * 128 + pitch];
+
+        // a note on with zero velocity is a note off
+        if (type == 0x9 && events.data2[i] > 0)
+        {
+            open.push_back({events.times[i], events.times[i], pitch, events.data2[i], channel, track});
+        }
+        else if ((type == 0x8 || type == 0x9) && !open.empty())
+        {
+            Note note = open.front();
+            open.erase(open.begin());
+            note.end = events.times[i];
+            notes.push_back(note);
+        }
+    }
+
+    const double track_end = events.count > 0 ? events.times[events.count - 1] : 0.0;
+    for (std::vector<Note> &open : open_notes)
+    {
+        for (Note &note : open)
+        {
+            note.end = std::max(note.start, track_end);
+            notes.push_back(note);
+        }
+    }
+}
+
+/// @brief Sorts the notes by start time and builds the index
+/// @param p_notes
+void NoteIndex::build(std::vector<Note> p_notes)
+{
+    notes = std::move(p_notes);
+    std::stable_sort(notes.begin(), notes.end(), [](const Note &a, const Note &b)
+                     { return a.start < b.start; });
+
+    max_ends.assign(notes.size(), 0.0);
+    build_subtree(0, notes.size());
+}
+
+/// @brief Builds the index from notes that are already sorted, e.g. read back from a file, without sorting them again
+/// @param p_notes sorted by start time like get_notes()
+/// @return false if the notes aren't sorted, the index is left unchanged then
+bool NoteIndex::assign(std::vector<Note> p_notes)
+{
+    for (size_t i = 1; i < p_notes.size(); i++)
+    {
+        if (p_notes[i].start < p_notes[i - 1].start)
+            return false;
+    }
+
+    notes = std::move(p_notes);
+    max_ends.assign(notes.size(), 0.0);
+    build_subtree(0, notes.size());
+    return true;
+}
+
+/// @brief Fills max_ends for the notes in [lo, hi)
+/// @return the latest end in the range
+double NoteIndex::build_subtree(size_t lo, size_t hi)
+{
+    if (lo >= hi)
+        return 0.0;
+
+    const size_t mid = lo + (hi - lo) / 2;
+    double max_end = notes[mid].end;
+    max_end = std::max(max_end, build_subtree(lo, mid));
+    max_end = std::max(max_end, build_subtree(mid + 1, hi));
+    max_ends[mid] = max_end;
+    return max_end;
+}
+
+/// @brief Collects the notes in [lo, hi) that start at or before t1 and end at or after t0
+/// whole subtrees are skipped when they end before t0 or start after t1
+template <typename Match>
+void NoteIndex::query_subtree(size_t lo, size_t hi, double t0, double t1, Match &&match, std::vector<int32_t> &result) const
+{
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (max_ends[mid] < t0)
+            return;
+
+        query_subtree(lo, mid, t0, t1, match, result);
+
+        // everything from mid on starts after the window
+        if (notes[mid].start > t1)
+            return;
+
+        if (match(notes[mid]))
+            result.push_back(static_cast<int32_t>(mid));
+
+        // continue with the right half without recursing
+        lo = mid + 1;
+    }
+}
+
+/// @brief Finds the notes that overlap [t0, t1] and have a pitch in [pitch_lo, pitch_hi]
+/// @param t0 seconds
+/// @param t1 seconds
+/// @param pitch_lo
+/// @param pitch_hi
+/// @param result [out] indices into get_notes(), in order of start time
+void NoteIndex::query_range(double t0, double t1, uint8_t pitch_lo, uint8_t pitch_hi, std::vector<int32_t> &result) const
+{
+    const auto match = [&](const Note &note)
+    {
+        return note.end >= t0 && note.pitch >= pitch_lo && note.pitch <= pitch_hi;
+    };
+    query_subtree(0, notes.size(), t0, t1, match, result);
+}
+
+/// @brief Finds the notes that are held at t, a note stops sounding at its end
+/// @param t seconds
+/// @param result [out] indices into get_notes(), in order of start time
+void NoteIndex::query_sounding(double t, std::vector<int32_t> &result) const
+{
+    const auto match = [&](const Note &note)
+    {
+        return note.end > t;
+    };
+    query_subtree(0, notes.size(), t, t, match, result);
+}
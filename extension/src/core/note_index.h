@@ -0,0 +1,56 @@
+#ifndef MIDI_NOTE_INDEX_H
+#define MIDI_NOTE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Paired note on/off events with an interval index for time range queries
+/// The notes are sorted by start time and double as an implicit balanced search tree:
+/// the middle of every index range is the root of that range, augmented with the latest end below it
+class NoteIndex
+{
+public:
+    struct Note
+    {
+        // seconds since the start of the song
+        double start;
+        double end;
+        uint8_t pitch;
+        uint8_t velocity;
+        uint8_t channel;
+        int32_t track;
+    };
+
+    /// @brief The columns of a track that are needed to pair its notes
+    struct TrackEvents
+    {
+        const uint8_t *statuses;
+        const uint8_t *data1;
+        const uint8_t *data2;
+        const double *times;
+        size_t count;
+    };
+
+    static void pair_track(const TrackEvents &events, int32_t track, std::vector<Note> &notes);
+
+    void build(std::vector<Note> notes);
+    bool assign(std::vector<Note> notes);
+    void query_range(double t0, double t1, uint8_t pitch_lo, uint8_t pitch_hi, std::vector<int32_t> &result) const;
+    void query_sounding(double t, std::vector<int32_t> &result) const;
+
+    /// @brief Gets the notes sorted by start time, query results index into this
+    /// @return
+    inline const std::vector<Note> &get_notes() const { return notes; }
+
+private:
+    std::vector<Note> notes;
+    // latest end of the subtree rooted at every index
+    std::vector<double> max_ends;
+
+    double build_subtree(size_t lo, size_t hi);
+    template <typename Match>
+    void query_subtree(size_t lo, size_t hi, double t0, double t1, Match &&match, std::vector<int32_t> &result) const;
+};
+
+#endif // MIDI_NOTE_INDEX_H
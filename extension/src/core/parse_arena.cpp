@@ -0,0 +1,63 @@
+#include "parse_arena.h"
+
+#include <new>
+
+ParseArena::ParseArena(size_t block_size)
+{
+    this->block_size = block_size;
+    this->last_block = nullptr;
+    this->cursor = nullptr;
+    this->end = nullptr;
+    this->heap_allocations = 0;
+    this->capacity = 0;
+}
+
+ParseArena::~ParseArena()
+{
+    reset();
+}
+
+/// @brief Makes sure the next `size` bytes can be allocated without another heap allocation
+/// @param size
+void ParseArena::reserve(size_t size)
+{
+    if (cursor == nullptr || static_cast<size_t>(end - cursor) < size)
+    {
+        add_block(size);
+    }
+}
+
+/// @brief Frees every block, all memory handed out by the arena becomes invalid
+void ParseArena::reset()
+{
+    while (last_block != nullptr)
+    {
+        Block *previous = last_block->previous;
+        ::operator delete(last_block);
+        last_block = previous;
+    }
+
+    cursor = nullptr;
+    end = nullptr;
+    capacity = 0;
+}
+
+/// @brief Allocates a new block, whatever is left of the current block is abandoned
+/// @param min_size the block will have at least this many usable bytes
+void ParseArena::add_block(size_t min_size)
+{
+    size_t size = min_size > block_size ? min_size : block_size;
+    // keep the usable memory aligned for any type
+    size_t header_size = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    Block *block = static_cast<Block *>(::operator new(header_size + size));
+
+    block->previous = last_block;
+    block->size = size;
+    last_block = block;
+
+    cursor = reinterpret_cast<uint8_t *>(block) + header_size;
+    end = cursor + size;
+    heap_allocations++;
+    capacity += size;
+}
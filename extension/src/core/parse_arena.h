@@ -0,0 +1,111 @@
+#ifndef MIDI_PARSE_ARENA_H
+#define MIDI_PARSE_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+/// @brief Monotonic bump allocator for intermediate parser state
+/// Memory is handed out from large blocks and never freed individually,
+/// everything is released at once when the arena is destroyed or reset
+class ParseArena
+{
+public:
+    explicit ParseArena(size_t block_size = 64 * 1024);
+    ~ParseArena();
+
+    ParseArena(const ParseArena &) = delete;
+    ParseArena &operator=(const ParseArena &) = delete;
+
+    /// @brief Allocates memory from the current block, grabbing a new block if it doesn't fit
+    /// @param size
+    /// @param alignment must be a power of two
+    /// @return
+    inline void *allocate(size_t size, size_t alignment)
+    {
+        uintptr_t address = (reinterpret_cast<uintptr_t>(cursor) + (alignment - 1)) & ~static_cast<uintptr_t>(alignment - 1);
+        if (cursor == nullptr || address + size > reinterpret_cast<uintptr_t>(end))
+        {
+            add_block(size + alignment);
+            address = (reinterpret_cast<uintptr_t>(cursor) + (alignment - 1)) & ~static_cast<uintptr_t>(alignment - 1);
+        }
+
+        cursor = reinterpret_cast<uint8_t *>(address + size);
+        return reinterpret_cast<void *>(address);
+    }
+
+    void reserve(size_t size);
+    void reset();
+
+    /// @brief Number of blocks requested from the heap since the arena was created
+    /// @return
+    inline size_t get_heap_allocation_count() const { return heap_allocations; }
+
+    /// @brief Total size of the blocks currently owned by the arena
+    /// @return
+    inline size_t get_capacity() const { return capacity; }
+
+private:
+    struct Block
+    {
+        Block *previous;
+        size_t size;
+    };
+
+    void add_block(size_t min_size);
+
+    size_t block_size;
+    Block *last_block;
+    uint8_t *cursor;
+    uint8_t *end;
+    size_t heap_allocations;
+    size_t capacity;
+};
+
+/// @brief std compatible allocator that takes its memory from a ParseArena
+/// deallocate is a no-op, the arena frees everything in one go,
+/// without an arena it falls back to the regular heap
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    // containers keep pointing at the arena their memory came from
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : arena(nullptr) {}
+    explicit ArenaAllocator(ParseArena *arena) : arena(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.get_arena()) {}
+
+    inline T *allocate(size_t count)
+    {
+        if (arena == nullptr)
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+
+        return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    inline void deallocate(T *pointer, size_t)
+    {
+        if (arena == nullptr)
+            ::operator delete(pointer);
+    }
+
+    inline ParseArena *get_arena() const { return arena; }
+
+    template <typename U>
+    inline bool operator==(const ArenaAllocator<U> &other) const { return arena == other.get_arena(); }
+
+    template <typename U>
+    inline bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.get_arena(); }
+
+private:
+    ParseArena *arena;
+};
+
+#endif // MIDI_PARSE_ARENA_H
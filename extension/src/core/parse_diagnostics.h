@@ -0,0 +1,126 @@
+#ifndef MIDI_PARSE_DIAGNOSTICS_H
+#define MIDI_PARSE_DIAGNOSTICS_H
+
+#include <cstdint>
+
+/// @brief Problems found while parsing a file, collected instead of printed
+/// Reporting an issue only bumps a counter and maybe stores an offset,
+/// formatting is left to whoever reads the diagnostics once parsing is done
+class ParseDiagnostics
+{
+public:
+    enum Category : uint8_t
+    {
+        // status byte that isn't defined by the midi specification
+        UnknownEvent,
+        // data byte with no running status to go with it
+        StrayDataByte,
+        // an event runs past the end of its track chunk
+        TruncatedTrack,
+        // variable length quantity longer than 4 bytes
+        InvalidData,
+        // track chunk without an end of track event
+        MissingEndOfTrack,
+        // bytes left in a track chunk after its end of track event
+        DataAfterEndOfTrack,
+        // chunk that is neither MThd nor MTrk
+        UnknownChunk,
+        // the header lists more tracks than the file contains
+        MissingTrack,
+        CategoryCount
+    };
+
+    /// @brief Number of offsets kept per category, the rest are only counted
+    static constexpr int MAX_OFFSETS = 8;
+
+    struct CategoryInfo
+    {
+        uint32_t count = 0;
+        // offsets of the first few issues, relative to whatever base the reporter used
+        int64_t offsets[MAX_OFFSETS] = {};
+    };
+
+    /// @brief Records an issue
+    /// @param category
+    /// @param offset where the issue was found
+    /// @param skipped number of bytes that were ignored because of it
+    inline void report(Category category, int64_t offset, int64_t skipped = 0)
+    {
+        CategoryInfo &info = categories[category];
+        if (info.count < MAX_OFFSETS)
+            info.offsets[info.count] = offset;
+        info.count++;
+        bytes_skipped += skipped;
+    }
+
+    /// @brief Adds the issues of another parse, e.g. a single track, to these diagnostics
+    /// @param other
+    /// @param base_offset added to the offsets of other
+    inline void merge(const ParseDiagnostics &other, int64_t base_offset)
+    {
+        for (int c = 0; c < CategoryCount; c++)
+        {
+            CategoryInfo &info = categories[c];
+            const CategoryInfo &other_info = other.categories[c];
+            for (uint32_t i = 0; i < other_info.count && i < MAX_OFFSETS; i++)
+            {
+                if (info.count + i < MAX_OFFSETS)
+                    info.offsets[info.count + i] = other_info.offsets[i] + base_offset;
+            }
+            info.count += other_info.count;
+        }
+        bytes_skipped += other.bytes_skipped;
+    }
+
+    inline void clear() { *this = ParseDiagnostics(); }
+
+    inline const CategoryInfo &get_category(Category category) const { return categories[category]; }
+    inline int64_t get_bytes_skipped() const { return bytes_skipped; }
+
+    /// @brief Gets whether anything at all was reported
+    /// @return
+    inline bool has_issues() const
+    {
+        for (int c = 0; c < CategoryCount; c++)
+        {
+            if (categories[c].count > 0)
+                return true;
+        }
+        return false;
+    }
+
+    /// @brief Gets the snake_case name of a category, used as the dictionary key
+    /// @param category
+    /// @return
+    static inline const char *get_category_name(Category category)
+    {
+        switch (category)
+        {
+        case UnknownEvent:
+            return "unknown_event";
+        case StrayDataByte:
+            return "stray_data_byte";
+        case TruncatedTrack:
+            return "truncated_track";
+        case InvalidData:
+            return "invalid_data";
+        case MissingEndOfTrack:
+            return "missing_end_of_track";
+        case DataAfterEndOfTrack:
+            return "data_after_end_of_track";
+        case UnknownChunk:
+            return "unknown_chunk";
+        case MissingTrack:
+            return "missing_track";
+        case CategoryCount:
+            break;
+        }
+        return "unknown";
+    }
+
+private:
+    CategoryInfo categories[CategoryCount];
+    int64_t bytes_skipped = 0;
+};
+
+#endif // MIDI_PARSE_DIAGNOSTICS_H
@@ -0,0 +1,102 @@
+#include "tempo_map.h"
+
+#include <algorithm>
+
+/// @brief Builds the segments from the tempo changes of every track
+/// @param division ticks per quarter note
+/// @param initial_tempo tempo until the first change, microseconds per quarter note
+/// @param changes the SetTempo events of all tracks in any order, changes on the same tick
+/// keep the last one (tracks should be passed in file order)
+void TempoMap::build(int32_t division, int32_t initial_tempo, std::vector<Change> changes)
+{
+    const double ticks_per_quarter = division > 0 ? static_cast<double>(division) : 1.0;
+
+    std::stable_sort(changes.begin(), changes.end(), [](const Change &a, const Change &b)
+                     { return a.tick < b.tick; });
+
+    segments.clear();
+    segments.push_back({0, 0.0, initial_tempo / ticks_per_quarter, initial_tempo});
+    for (const Change &change : changes)
+    {
+        Segment &last = segments.back();
+        const int64_t tick = std::max<int64_t>(change.tick, 0);
+        if (tick == last.start_tick)
+        {
+            // replaces the tempo of a segment that has no length yet
+            last.tempo = change.tempo;
+            last.microseconds_per_tick = change.tempo / ticks_per_quarter;
+            continue;
+        }
+
+        const double start_seconds = last.start_seconds + (tick - last.start_tick) * last.microseconds_per_tick / 1000000.0;
+        segments.push_back({tick, start_seconds, change.tempo / ticks_per_quarter, change.tempo});
+    }
+}
+
+/// @brief Takes segments that were built before, e.g. read back from a file
+/// @param p_segments in time order, the first one starting at tick 0
+/// @return false if the segments don't fit that, the map is left unchanged then
+bool TempoMap::assign(std::vector<Segment> p_segments)
+{
+    if (p_segments.empty() || p_segments.front().start_tick != 0)
+        return false;
+
+    for (size_t i = 1; i < p_segments.size(); i++)
+    {
+        if (p_segments[i].start_tick <= p_segments[i - 1].start_tick || p_segments[i].start_seconds < p_segments[i - 1].start_seconds)
+            return false;
+    }
+
+    segments = std::move(p_segments);
+    return true;
+}
+
+/// @brief Finds the segment a tick falls into
+/// @param tick
+/// @return index into get_segments()
+size_t TempoMap::find_segment(double tick) const
+{
+    const auto it = std::upper_bound(segments.begin(), segments.end(), tick, [](double value, const Segment &segment)
+                                     { return value < segment.start_tick; });
+    return it == segments.begin() ? 0 : static_cast<size_t>(it - segments.begin()) - 1;
+}
+
+/// @brief Converts a position in ticks into seconds since the start of the song
+/// @param tick
+/// @return
+double TempoMap::tick_to_seconds(double tick) const
+{
+    const Segment &segment = segments[find_segment(tick)];
+    return segment.start_seconds + (tick - segment.start_tick) * segment.microseconds_per_tick / 1000000.0;
+}
+
+/// @brief Converts seconds since the start of the song into a position in ticks
+/// @param seconds
+/// @return the tick, fractional between two ticks
+double TempoMap::seconds_to_tick(double seconds) const
+{
+    const auto it = std::upper_bound(segments.begin(), segments.end(), seconds, [](double value, const Segment &segment)
+                                     { return value < segment.start_seconds; });
+    const Segment &segment = it == segments.begin() ? segments.front() : *(it - 1);
+    if (segment.microseconds_per_tick <= 0.0)
+        return static_cast<double>(segment.start_tick);
+
+    return segment.start_tick + (seconds - segment.start_seconds) * 1000000.0 / segment.microseconds_per_tick;
+}
+
+/// @brief Converts the ticks of a track into seconds, walking the segments instead of searching them
+/// @param ticks absolute ticks in ascending order
+/// @param count
+/// @param seconds [out] count values
+void TempoMap::ticks_to_seconds(const int32_t *ticks, size_t count, double *seconds) const
+{
+    size_t segment = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        while (segment + 1 < segments.size() && segments[segment + 1].start_tick <= ticks[i])
+            segment++;
+
+        const Segment &current = segments[segment];
+        seconds[i] = current.start_seconds + (ticks[i] - current.start_tick) * current.microseconds_per_tick / 1000000.0;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef MIDI_TEMPO_MAP_H
+#define MIDI_TEMPO_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Piecewise linear mapping between ticks and seconds
+/// The SetTempo events of every track are merged into segments of constant tempo,
+/// converting a tick or a time is a binary search over the segments
+class TempoMap
+{
+public:
+    /// @brief A SetTempo event
+    struct Change
+    {
+        int64_t tick;
+        // microseconds per quarter note
+        int32_t tempo;
+    };
+
+    /// @brief A stretch of the song with a constant tempo, runs until the next segment starts
+    struct Segment
+    {
+        int64_t start_tick;
+        double start_seconds;
+        double microseconds_per_tick;
+        // microseconds per quarter note
+        int32_t tempo;
+    };
+
+    TempoMap() { build(48, 500000, std::vector<Change>()); }
+
+    void build(int32_t division, int32_t initial_tempo, std::vector<Change> changes);
+    bool assign(std::vector<Segment> segments);
+
+    double tick_to_seconds(double tick) const;
+    double seconds_to_tick(double seconds) const;
+    size_t find_segment(double tick) const;
+    void ticks_to_seconds(const int32_t *ticks, size_t count, double *seconds) const;
+
+    /// @brief Gets the segments in time order, there is always at least one starting at tick 0
+    /// @return
+    inline const std::vector<Segment> &get_segments() const { return segments; }
+
+private:
+    std::vector<Segment> segments;
+};
+
+#endif // MIDI_TEMPO_MAP_H
@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    data = nullptr;
+    size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/// @brief Whether memory mapping is available on this platform
+/// @return
+bool MappedFile::is_supported()
+{
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// @brief Maps a file into memory
+/// @param p_path a godot path (res://, user://) or an absolute path
+/// @return true if the file was mapped, false if the caller should use buffered reads instead
+bool MappedFile::open(const String &p_path)
+{
+    close();
+
+#ifdef __linux__
+    // in exported projects res:// files live inside of the pack file,
+    // there is nothing on disk we could map
+    if (p_path.begins_with("res://") && !OS::get_singleton()->has_feature("editor"))
+    {
+        return false;
+    }
+
+    String global_path = ProjectSettings::get_singleton()->globalize_path(p_path);
+
+    int fd = ::open(global_path.utf8().get_data(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+        // empty files can't be mapped
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // chunks are read front to back, let the kernel read ahead
+    madvise(mapping, file_stat.st_size, MADV_SEQUENTIAL);
+
+    data = static_cast<const uint8_t *>(mapping);
+    size = file_stat.st_size;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// @brief Unmaps the file, any spans from get_bytes are invalid after this
+void MappedFile::close()
+{
+#ifdef __linux__
+    if (data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
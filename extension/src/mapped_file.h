@@ -0,0 +1,40 @@
+#ifndef MIDI_MAPPED_FILE_H
+#define MIDI_MAPPED_FILE_H
+
+#include <godot_cpp/variant/string.hpp>
+
+#include "core/byte_span.h"
+
+using namespace godot;
+
+/// @brief Read-only memory mapping of a file on disk
+/// Only available on Linux, everywhere else (and for files inside of
+/// exported pack files) open will fail and callers should fall back to FileAccess
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const String &p_path);
+    void close();
+
+    /// @brief Whether a file is currently mapped
+    /// @return
+    inline bool is_open() const { return data != nullptr; }
+
+    /// @brief Gets a view of the whole mapping, only valid until the file is closed
+    /// @return
+    inline ByteSpan get_bytes() const { return ByteSpan(data, size); }
+
+    static bool is_supported();
+
+private:
+    const uint8_t *data;
+    int64_t size;
+};
+
+#endif // MIDI_MAPPED_FILE_H
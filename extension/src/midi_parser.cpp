@@ -1,16 +1,38 @@
 #include "midi_parser.h"
 
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+
+#include "core/midi_probe.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
 
 using namespace godot;
 
 /// @brief override method for registering c++ functions in godot
 void MidiParser::_bind_methods()
 {
+    ClassDB::bind_method(D_METHOD("feed", "bytes"), &MidiParser::feed);
+    ClassDB::bind_method(D_METHOD("poll"), &MidiParser::poll);
+    ClassDB::bind_method(D_METHOD("reset"), &MidiParser::reset);
+    ClassDB::bind_method(D_METHOD("is_finished"), &MidiParser::is_finished);
+    ClassDB::bind_method(D_METHOD("has_header"), &MidiParser::has_header);
+    ClassDB::bind_method(D_METHOD("get_format"), &MidiParser::get_format);
+    ClassDB::bind_method(D_METHOD("get_track_count"), &MidiParser::get_track_count);
+    ClassDB::bind_method(D_METHOD("get_division"), &MidiParser::get_division);
+    ClassDB::bind_method(D_METHOD("get_sysex_data"), &MidiParser::get_sysex_data);
+
+    ClassDB::bind_static_method("MidiParser", D_METHOD("probe", "path"), &MidiParser::probe);
 }
 
 MidiParser::MidiParser()
 {
+    reset();
 }
 
 MidiParser::~MidiParser()
@@ -19,30 +41,17 @@ MidiParser::~MidiParser()
 
 /// @brief Loads a Midi chunk from a stream of bytes
 /// @param bytes the input stream of bytes
-/// @return the original byte stream minus the read data
-PackedByteArray MidiParser::RawMidiChunk::load_from_bytes(PackedByteArray bytes)
+/// @return a view of the original byte stream minus the read data, nothing is copied
+ByteSpan MidiParser::RawMidiChunk::load_from_bytes(const ByteSpan &bytes)
 {
-    chunk_id = bytes.slice(0, 4).get_string_from_ascii();
-    // we have to use this custom function because chunk size is stored in big endian
-    chunk_size = Utility::decode_int32_be(bytes, 4);
-    chunk_data = bytes.slice(8, 8 + chunk_size);
-    // remove the chunk from the input stream
-    PackedByteArray new_bytes = bytes.slice(8 + chunk_size);
-
-    if (chunk_id == "MThd")
-    {
-        chunk_type = MidiChunkType::Header;
-    }
-    else if (chunk_id == "MTrk")
-    {
-        chunk_type = MidiChunkType::Track;
-    }
-    else
-    {
-        // unknown header type
-        // this will be ignored per the midi specification
-        chunk_type = MidiChunkType::Unknown;
-    }
+    MidiFile::Chunk chunk;
+    ByteSpan new_bytes = MidiFile::read_chunk(bytes, chunk);
+
+    chunk_id = Utility::decode_string_ascii(ByteSpan(reinterpret_cast<const uint8_t *>(chunk.id), bytes.size >= 8 ? 4 : 0));
+    chunk_size = chunk.size;
+    chunk_data = chunk.data;
+    // MidiChunkType has the same values as MidiFile::ChunkType
+    chunk_type = (MidiChunkType)chunk.type;
 
     return new_bytes;
 }
@@ -55,44 +64,29 @@ MidiParser::MidiHeaderChunk::MidiHeaderChunk()
     division_type = MidiDivisionType::TicksPerQuarterNote;
     division = 48;
     tempo = 500000;
-    only_notes = false;
 }
 
 /// @brief parses a chunk of raw bytes into a header chunk
 /// @param raw the raw chunk of bytes
 /// @param header the header chunk to populate
 /// @return true if the chunk was parsed successfully, false otherwise
-bool MidiParser::MidiHeaderChunk::parse_chunk(RawMidiChunk raw, MidiHeaderChunk &header)
+bool MidiParser::MidiHeaderChunk::parse_chunk(const RawMidiChunk &raw, MidiHeaderChunk &header)
 {
-    if (raw.chunk_type != MidiChunkType::Header)
-        return false;
-
-    // data section of a header contains 3 16-bit words
-    // first word is format
-    // 0 - single track, 1 - multiple tracks, 2 - multiple songs
-    file_format = (MidiFileFormat)Utility::decode_int16_be(raw.chunk_data, 0);
-
-    // second word is number of tracks
-    num_tracks = Utility::decode_int16_be(raw.chunk_data, 2);
-
-    // third word is time division
-    // ticks per quarter note or (negative SMPTE format + ticks per frame)
-    // if bit 15 is 0, then it's ticks per quarter note
-    // if bit 15 is 1, then it's SMPTE format
+    MidiFile::Chunk chunk;
+    chunk.size = raw.chunk_size;
+    chunk.data = raw.chunk_data;
+    chunk.type = (MidiFile::ChunkType)raw.chunk_type;
 
-    // we use bit 15 to determine the division type
-    // the bytes are in big endian, so we have to shift the byte to the right
-    // and then mask it with 0x01 to get the bit
-    division_type = (MidiDivisionType)((raw.chunk_data[4] >> 7) & 0x01);
+    MidiFile::FileHeader file_header;
+    if (!MidiFile::read_header(chunk, file_header))
+        return false;
 
-    // if it's ticks per quarter note, then we just read the value
+    file_format = (MidiFileFormat)file_header.format;
+    num_tracks = file_header.num_tracks;
+    division_type = (MidiDivisionType)file_header.division_type;
     if (division_type == MidiDivisionType::TicksPerQuarterNote)
     {
-        division = static_cast<int32_t>(Utility::decode_int16_be(raw.chunk_data, 4));
-    }
-    else
-    {
-        // TODO: implement SMPTE format
+        division = file_header.division;
     }
 
     return true;
@@ -132,70 +126,37 @@ String MidiParser::MidiEvent::to_string() const
 
 /// @brief Constructor for MIDI note events
 /// @param channel the MIDI channel
-/// @param delta the delta time in microseconds
-/// @param data the data for the event
+/// @param delta the delta time in ticks
+/// @param note the first data byte (note, controller number, program, etc.)
+/// @param data the second data byte (velocity, controller value, etc.), 0 for single byte messages
 /// @param event_type the type of the event
-MidiParser::MidiEventNote::MidiEventNote(int32_t channel, double delta, PackedByteArray data, NoteType event_type) : MidiEvent(channel, delta)
+MidiParser::MidiEventNote::MidiEventNote(int32_t channel, double delta, uint8_t note, uint8_t data, NoteType event_type) : MidiEvent(channel, delta)
 {
     this->event_type = event_type;
-
-    if (
-        event_type == NoteType::NoteOn ||
-        event_type == NoteType::NoteOff ||
-        event_type == NoteType::Aftertouch ||
-        event_type == NoteType::Controller ||
-        event_type == NoteType::PitchBend)
-    {
-        this->channel = channel;
-        this->note = data[1];
-        this->data = data[2];
-        this->bytes_used = 2;
-    }
-    else if (event_type == NoteType::ProgramChange ||
-             event_type == NoteType::ChannelPressure)
-    {
-        this->channel = channel;
-        this->note = data[1];
-        bytes_used = 1;
-    }
-    else
-    {
-        // unknown/invalid event type
-        // let's assume it's some weird controller event and set the bytes used to 2
-        this->channel = channel;
-        this->note = data[1];
-        this->data = data[2];
-        this->bytes_used = 2;
-    }
+    this->note = note;
+    this->data = data;
+    this->bytes_used = MidiDecoder::get_status_info(static_cast<uint8_t>((event_type << 4) | channel)).data_length;
 }
 
 /// @brief Constructor for MIDI system events
 /// @param delta
-/// @param data
-MidiParser::MidiEventSystem::MidiEventSystem(double delta, PackedByteArray data) : MidiEvent(0, delta)
+/// @param status the status byte
+MidiParser::MidiEventSystem::MidiEventSystem(double delta, uint8_t status) : MidiEvent(0, delta)
 {
-    event_type = (MidiSystemEventType)data[0];
-    bytes_used = 1;
+    event_type = (MidiSystemEventType)status;
+    bytes_used = MidiDecoder::get_status_info(status).data_length;
 }
 
 /// @brief Constructor for MIDI meta events
 /// @param delta
-/// @param data
-MidiParser::MidiEventMeta::MidiEventMeta(double delta, PackedByteArray data) : MidiEvent(0, delta)
+/// @param event_type the meta event type
+/// @param data the payload of the event
+MidiParser::MidiEventMeta::MidiEventMeta(double delta, MidiMetaEventType event_type, const ByteSpan &data) : MidiEvent(0, delta)
 {
-    // the first byte is always 0xFF
-    // the second and third bytes are the event type and length
-    event_type = (MidiMetaEventType)data[1];
-    event_data_length = Utility::decode_varint_be(data, 2, bytes_used);
-
-    // if we have a non-zero length, then we have data
-    if (event_data_length > 0)
-    {
-        this->data = data.slice(bytes_used + 2, (bytes_used + 2) + event_data_length);
-    }
-
-    // increment bytes used
-    bytes_used = event_data_length + bytes_used + 1;
+    this->event_type = event_type;
+    this->data = data;
+    event_data_length = static_cast<int32_t>(data.size);
+    bytes_used = event_data_length;
 
     // Begin processing the various subtypes of meta events
     // text events
@@ -216,7 +177,7 @@ MidiParser::MidiEventMeta::MidiEventMeta(double delta, PackedByteArray data) : M
         // first byte is always 0x06
         // second byte is the length of the text
         // the rest of the bytes are the text
-        this->meta_data = this->data.slice(0, this->event_data_length).get_string_from_ascii();
+        this->meta_data = Utility::decode_string_ascii(this->data);
 
         return;
     }
@@ -230,6 +191,8 @@ MidiParser::MidiEventMeta::MidiEventMeta(double delta, PackedByteArray data) : M
         // the bytes are the tempo in microseconds per quarter note
 
         // set tempo of the track
+        if (this->data.size < 3)
+            break;
         this->meta_data = Utility::decode_int24_be(this->data, 0);
         break;
     }
@@ -245,6 +208,8 @@ MidiParser::MidiEventMeta::MidiEventMeta(double delta, PackedByteArray data) : M
         // the fourth byte is the number of 32nd notes per quarter note
 
         // set time signature of the track
+        if (this->data.size < 4)
+            break;
         Dictionary time_signature;
         time_signature["numerator"] = this->data[0];
         time_signature["denominato"] = (int32_t)pow(2, this->data[1]);
@@ -263,6 +228,8 @@ MidiParser::MidiEventMeta::MidiEventMeta(double delta, PackedByteArray data) : M
         // the second byte is the major (0) or minor (1) key
 
         // set key signature of the track
+        if (this->data.size < 2)
+            break;
         Dictionary key_signature;
         key_signature["sharps_flats"] = this->data[0];
         key_signature["major_minor"] = this->data[1];
@@ -299,150 +266,443 @@ MidiParser::MidiEventMeta::MidiEventMeta(double delta, PackedByteArray data) : M
 
 /// @brief The main chunk parser, takes bytes from the input stream and parses them into MIDI chunks
 /// @param raw the raw chunk of bytes
-/// @param header the header chunk (will be modified for tempo changes, etc.)
+/// @param header the header chunk, read only so tracks can be parsed in parallel
 /// @return
-bool MidiParser::MidiTrackChunk::parse_chunk(RawMidiChunk raw, MidiHeaderChunk &header)
+bool MidiParser::MidiTrackChunk::parse_chunk(const RawMidiChunk &raw, const MidiHeaderChunk &header)
 {
     if (raw.chunk_type != MidiChunkType::Track)
         return false;
 
-    // read events until we reach the end of the chunk
-    // we have to use a while loop because we don't know how many events there are
-    // we can only know when we reach the end of the chunk
-    int32_t offset = 0;
-    header.end_of_track = false;
-    while (offset < raw.chunk_size)
-    {
-        if (header.end_of_track)
-            break;
+    decode(raw.chunk_data);
+    return true;
+}
 
-        int32_t bytes_used = 0;
+/// @brief Parses track chunks on the WorkerThreadPool
+/// tracks don't depend on each other once the chunk boundaries are known,
+/// so each one is decoded independently and stored at its original index
+/// @param raw_tracks the track chunks, in file order
+/// @param header the parsed header chunk
+/// @param filters the events to keep, one per track or empty to keep every event
+/// @param tracks [out] the parsed tracks, in the same order as raw_tracks
+/// @return the index of the first track that failed to parse, or -1 on success
+int32_t MidiParser::parse_tracks(const std::vector<RawMidiChunk> &raw_tracks, const MidiHeaderChunk &header, const std::vector<EventFilter> &filters, std::vector<MidiTrackChunk> &tracks)
+{
+    const size_t num_tracks = raw_tracks.size();
+    tracks.clear();
+    tracks.resize(num_tracks);
+    for (size_t i = 0; i < num_tracks && i < filters.size(); i++)
+    {
+        tracks[i].filter = filters[i];
+    }
 
-        // first variable length quantity is delta time
-        int32_t delta_time = Utility::decode_varint_be(raw.chunk_data, offset, bytes_used);
-        offset += bytes_used;
+    // hand out the biggest tracks first so one large track doesn't
+    // end up running alone at the end
+    std::vector<uint32_t> order(num_tracks);
+    for (size_t i = 0; i < num_tracks; i++)
+    {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&raw_tracks](uint32_t a, uint32_t b)
+                     { return raw_tracks[a].chunk_size > raw_tracks[b].chunk_size; });
 
-        // next byte is the event type | channel
-        int32_t event_type = raw.chunk_data[offset];
-        offset += 1;
+    // one flag per track, each task only writes the slot of its own track
+    std::vector<uint8_t> parsed(num_tracks, 0);
+    TrackJob job = {&raw_tracks, &header, &tracks, &order, &parsed};
 
-        // the event type is the first 4 bits of the byte
-        // the channel is the last 4 bits
-        int32_t event_code = event_type >> 4;
-        int32_t channel = event_type & 0x0F;
+    // the pool is shared with the rest of the engine (and with load_file_async), so the
+    // tracks are spread over its threads instead of starting new ones for every load
+    const int32_t num_tasks = std::min<int32_t>(OS::get_singleton()->get_processor_count(), static_cast<int32_t>(num_tracks));
+    if (num_tasks <= 1 || OS::get_singleton()->has_feature("nothreads"))
+    {
+        for (uint32_t n = 0; n < num_tracks; n++)
+        {
+            job.parse(n);
+        }
+    }
+    else
+    {
+        // group tasks call a method of a live object, the job only lives for this call
+        Ref<MidiParser> runner;
+        runner.instantiate();
+        runner->track_job = &job;
+        WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+        const int64_t group = pool->add_group_task(callable_mp(runner.ptr(), &MidiParser::parse_track_task), static_cast<int>(num_tracks), num_tasks, true, "[GodotMidi] Parsing tracks");
+        pool->wait_for_group_task_completion(group);
+    }
 
-        // special case for meta events
-        if (event_type == 0xFF)
+    for (size_t i = 0; i < num_tracks; i++)
+    {
+        if (!parsed[i])
         {
-            event_code = 0xFF;
+            return static_cast<int32_t>(i);
         }
+    }
+
+    return -1;
+}
+
+/// @brief Parses the n-th biggest track of a parse_tracks call
+/// @param n position in the size order, not the track index
+void MidiParser::TrackJob::parse(uint32_t n) const
+{
+    const uint32_t trk_idx = (*order)[n];
+    (*parsed)[trk_idx] = (*tracks)[trk_idx].parse_chunk((*raw_tracks)[trk_idx], *header) ? 1 : 0;
+}
+
+/// @brief Group task body of parse_tracks, runs on a WorkerThreadPool thread
+/// @param p_index
+void MidiParser::parse_track_task(uint32_t p_index)
+{
+    track_job->parse(p_index);
+}
+
+/// @brief Copies the payload of a meta or sysex event to the end of a buffer
+/// @param event [in,out] the decoded event, its payload offset is moved to the copy
+/// @param track the track data the event was decoded from
+/// @param buffer [in,out] the payload is appended here
+void MidiParser::relocate_payload(MidiDecoder::Event &event, const ByteSpan &track, PackedByteArray &buffer)
+{
+    ByteSpan payload = track.slice(event.payload_offset, event.payload_offset + event.payload_length);
+    int64_t buffer_offset = buffer.size();
+    if (payload.size > 0)
+    {
+        buffer.resize(buffer_offset + payload.size);
+        memcpy(buffer.ptrw() + buffer_offset, payload.data, payload.size);
+    }
+
+    event.payload_offset = buffer_offset;
+    event.payload_length = static_cast<uint32_t>(payload.size);
+}
+
+/// @brief Converts a decoded event into the dictionary format used by MidiResource tracks
+/// @param event the decoded event, sysex payloads must already be relocated into the sysex buffer
+/// @param payloads the bytes meta payload offsets point into (the track data or a relocated copy)
+/// @param track_index
+/// @return an empty dictionary for events that aren't exposed
+Dictionary MidiParser::make_event_dictionary(const MidiDecoder::Event &event, const ByteSpan &payloads, int32_t track_index)
+{
+    Dictionary event_dict;
+    double delta = (double)event.delta;
+
+    switch (event.kind)
+    {
+    // meta events
+    case MidiDecoder::EventKind::Meta:
+    {
+        ByteSpan payload = payloads.slice(event.payload_offset, event.payload_offset + event.payload_length);
+        MidiEventMeta meta_event = MidiEventMeta(delta, (MidiEventMeta::MidiMetaEventType)event.meta_type, payload);
+
+        event_dict["type"] = "meta";
+        event_dict["track"] = track_index;
+        // cast to int
+        event_dict["subtype"] = static_cast<int64_t>(meta_event.event_type);
+        event_dict["delta"] = delta;
+        // since raw data is almost never useful for meta events, we store it as a variant
+        // and put it in the data field
+        event_dict["data"] = static_cast<Variant>(meta_event.meta_data);
+        event_dict["channel"] = meta_event.channel;
+        break;
+    }
+
+    // note events
+    case MidiDecoder::EventKind::Channel:
+    {
+        event_dict["type"] = "note";
+        event_dict["track"] = track_index;
+        event_dict["subtype"] = event.status >> 4;
+        event_dict["delta"] = delta;
+        event_dict["note"] = event.data1;
+        event_dict["data"] = event.data2;
+        event_dict["channel"] = event.status & 0x0F;
+        break;
+    }
+
+    // system events
+    case MidiDecoder::EventKind::System:
+    {
+        event_dict["type"] = "system";
+        event_dict["track"] = track_index;
+        event_dict["subtype"] = event.status;
+        event_dict["delta"] = delta;
+        event_dict["channel"] = 0;
+        break;
+    }
+
+    // system exclusive events, 0xF0 packets and 0xF7 continuations/escapes
+    case MidiDecoder::EventKind::SysEx:
+    {
+        event_dict["type"] = "sysex";
+        event_dict["track"] = track_index;
+        event_dict["subtype"] = event.status;
+        event_dict["delta"] = delta;
+        event_dict["offset"] = event.payload_offset;
+        event_dict["length"] = event.payload_length;
+        event_dict["channel"] = 0;
+        break;
+    }
+
+    case MidiDecoder::EventKind::Unknown:
+        break;
+    }
 
-        PackedByteArray event_data = raw.chunk_data.slice(offset - 1, raw.chunk_size);
+    return event_dict;
+}
 
-        // the event code determines the type of the event
-        std::unique_ptr<MidiEvent> ptr;
-        switch (event_code)
+/// @brief Appends bytes to the incremental parser, call poll() afterwards to get the events
+/// @param p_bytes the next part of the file, can be split anywhere
+void MidiParser::feed(const PackedByteArray &p_bytes)
+{
+    const uint8_t *bytes = p_bytes.ptr();
+    stream_buffer.insert(stream_buffer.end(), bytes, bytes + p_bytes.size());
+}
+
+/// @brief Decodes as many events as the fed bytes allow
+/// incomplete events, chunk headers and delta times are kept until more bytes arrive
+/// @return the events completed since the last call, in the same format as MidiResource tracks
+Array MidiParser::poll()
+{
+    Array events;
+    ByteSpan bytes(stream_buffer.data(), static_cast<int64_t>(stream_buffer.size()));
+    int64_t offset = 0;
+
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        ByteSpan available = bytes.slice(offset);
+
+        switch (stream_stage)
         {
-        case 0x08: // note off
+        case StreamStage::WaitingForHeader:
         {
-            MidiEventNote note_off_event = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::NoteOff);
-            offset += note_off_event.get_bytes_used();
-            note_events.push_back(note_off_event);
-            ptr = std::make_unique<MidiEventNote>(note_off_event);
-            events.push_back(std::move(ptr));
+            if (available.size < 8)
+                break;
+
+            int64_t chunk_size = 0;
+            if (!MidiFile::read_chunk_size(available, chunk_size))
+            {
+                UtilityFunctions::print("[GodotMidi] Error: Header chunk length is corrupt.");
+                stream_stage = StreamStage::Finished;
+                break;
+            }
+            chunk_size += 8;
+            if (available.size < chunk_size)
+                break;
+
+            RawMidiChunk header_chunk;
+            header_chunk.load_from_bytes(available.slice(0, chunk_size));
+            if (!stream_header.parse_chunk(header_chunk, stream_header))
+            {
+                UtilityFunctions::print("[GodotMidi] Error: Could not parse header chunk.");
+                stream_stage = StreamStage::Finished;
+                break;
+            }
+
+            offset += chunk_size;
+            stream_stage = StreamStage::WaitingForChunkHeader;
+            progress = true;
             break;
         }
-        case 0x09: // note on
+        case StreamStage::WaitingForChunkHeader:
         {
-            MidiEventNote note_on_event = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::NoteOn);
-            offset += note_on_event.get_bytes_used();
-            note_events.push_back(note_on_event);
-            ptr = std::make_unique<MidiEventNote>(note_on_event);
-            events.push_back(std::move(ptr));
+            if (stream_track + 1 >= stream_header.num_tracks)
+            {
+                stream_stage = StreamStage::Finished;
+                break;
+            }
+            if (available.size < 8)
+                break;
+
+            if (!MidiFile::read_chunk_size(available, chunk_remaining))
+            {
+                UtilityFunctions::print(String("[GodotMidi] Error: Chunk length is corrupt after track ") + String::num_int64(stream_track));
+                stream_stage = StreamStage::Finished;
+                break;
+            }
+            // unknown chunks are skipped per the midi specification
+            if (available.starts_with("MTrk"))
+            {
+                stream_track++;
+                stream_state = MidiDecoder::State();
+                stream_dropped_delta = 0;
+                stream_stage = StreamStage::ReadingTrack;
+            }
+            else
+            {
+                stream_stage = StreamStage::SkippingChunk;
+            }
+
+            offset += 8;
+            progress = true;
             break;
         }
-        case 0x0A: // note aftertouch
+        case StreamStage::ReadingTrack:
         {
-            MidiEventNote note_aftertouch_event = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::Aftertouch);
-            offset += note_aftertouch_event.get_bytes_used();
-            note_events.push_back(note_aftertouch_event);
-            ptr = std::make_unique<MidiEventNote>(note_aftertouch_event);
-            events.push_back(std::move(ptr));
+            int64_t used = poll_track(available, events);
+            offset += used;
+            chunk_remaining -= used;
+            progress = stream_stage != StreamStage::ReadingTrack;
             break;
         }
-        case 0x0B: // controller
+        case StreamStage::SkippingChunk:
         {
-            MidiEventNote note_controller_event = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::Controller);
-            offset += note_controller_event.get_bytes_used();
-            note_events.push_back(note_controller_event);
-            ptr = std::make_unique<MidiEventNote>(note_controller_event);
-            events.push_back(std::move(ptr));
+            int64_t skipped = std::min(available.size, chunk_remaining);
+            offset += skipped;
+            chunk_remaining -= skipped;
+            if (chunk_remaining == 0)
+            {
+                stream_stage = StreamStage::WaitingForChunkHeader;
+                progress = true;
+            }
             break;
         }
-        case 0x0C: // program change
-        {
-            MidiEventNote note_program_change = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::ProgramChange);
-            offset += note_program_change.get_bytes_used();
-            note_events.push_back(note_program_change);
-            ptr = std::make_unique<MidiEventNote>(note_program_change);
-            events.push_back(std::move(ptr));
+        case StreamStage::Finished:
             break;
         }
-        case 0x0D: // channel pressure
+    }
+
+    // drop the consumed bytes, only the unfinished tail is kept
+    stream_buffer.erase(stream_buffer.begin(), stream_buffer.begin() + offset);
+    return events;
+}
+
+/// @brief Decodes the complete events at the start of bytes for the current track
+/// @param bytes the unconsumed bytes, may end anywhere inside of the track
+/// @param events [out] the decoded events are appended
+/// @return the number of bytes consumed
+int64_t MidiParser::poll_track(const ByteSpan &bytes, Array &events)
+{
+    ByteSpan track = bytes.slice(0, chunk_remaining);
+    // once the whole chunk is here a short event is damage, not missing data
+    const bool complete = track.size == chunk_remaining;
+
+    MidiDecoder::Event event;
+    int64_t offset = 0;
+    while (true)
+    {
+        MidiDecoder::Result result = MidiDecoder::decode_event(track, offset, stream_state, event);
+        if (result == MidiDecoder::Result::EndOfData)
         {
-            MidiEventNote note_channel_pressure = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::ChannelPressure);
-            offset += note_channel_pressure.get_bytes_used();
-            note_events.push_back(note_channel_pressure);
-            ptr = std::make_unique<MidiEventNote>(note_channel_pressure);
-            events.push_back(std::move(ptr));
-            break;
+            if (complete)
+                stream_stage = StreamStage::WaitingForChunkHeader;
+            return offset;
         }
-        case 0x0E: // pitch bend
+
+        if (result != MidiDecoder::Result::Ok)
         {
-            MidiEventNote note_pitch_blend = MidiEventNote(channel, delta_time, event_data, MidiEventNote::NoteType::PitchBend);
-            offset += note_pitch_blend.get_bytes_used();
-            note_events.push_back(note_pitch_blend);
-            ptr = std::make_unique<MidiEventNote>(note_pitch_blend);
-            events.push_back(std::move(ptr));
-            break;
+            if (!complete)
+                return offset;
+
+            UtilityFunctions::print(String("[GodotMidi] Warning: Track data is truncated or corrupt in track ") + String::num_int64(stream_track));
+            stream_stage = StreamStage::SkippingChunk;
+            return offset;
         }
-        case 0x0F: // system event
+
+        if (event.kind == MidiDecoder::EventKind::Unknown)
         {
-            MidiEventSystem system_event = MidiEventSystem(delta_time, event_data);
-            offset += system_event.get_bytes_used();
-            system_events.push_back(system_event);
-            ptr = std::make_unique<MidiEventSystem>(system_event);
-            events.push_back(std::move(ptr));
-            break;
+            // the stray byte is skipped, its time goes to the next event so the ticks don't shift
+            stream_dropped_delta += event.delta;
+            continue;
         }
-        case 0xFF: // meta event
+        event.delta += stream_dropped_delta;
+        stream_dropped_delta = 0;
+
+        if (event.kind == MidiDecoder::EventKind::SysEx)
         {
-            MidiEventMeta meta_event = MidiEventMeta(delta_time, event_data);
-            offset += meta_event.get_bytes_used();
-            meta_events.push_back(meta_event);
-            ptr = std::make_unique<MidiEventMeta>(meta_event);
-            events.push_back(std::move(ptr));
-            break;
+            relocate_payload(event, track, stream_sysex_data);
         }
-        case 0xF0: // system exclusive
+
+        Dictionary event_dict = make_event_dictionary(event, track, stream_track);
+        if (!event_dict.is_empty())
         {
-            int bytes_used = 0;
-            int length = Utility::decode_varint_be(event_data, 0, bytes_used);
-            UtilityFunctions::print(String("System exclusive event, length: ") + String::num_int64(length));
-            offset += length + bytes_used;
-            break;
+            events.push_back(event_dict);
         }
-        default:
+
+        if (event.kind == MidiDecoder::EventKind::Meta && event.meta_type == MidiDecoder::META_END_OF_TRACK)
         {
-            // unknown event type
-            UtilityFunctions::print(String("Unknown event type: ") + String::num_int64(event_code));
-            // print data as hex
-            UtilityFunctions::print(event_data.slice(0, 10).hex_encode() + String("..."));
-            //  print delta time (parsed)
-            UtilityFunctions::print(String("Delta time: ") + String::num_int64(delta_time));
-        }
+            // anything after the end of track event is ignored
+            stream_stage = StreamStage::SkippingChunk;
+            return offset;
         }
     }
+}
 
-    return true;
+/// @brief Clears the incremental parser so a new file can be fed
+void MidiParser::reset()
+{
+    stream_buffer.clear();
+    stream_sysex_data.clear();
+    stream_stage = StreamStage::WaitingForHeader;
+    stream_header = MidiHeaderChunk();
+    chunk_remaining = 0;
+    stream_track = -1;
+    stream_state = MidiDecoder::State();
+    stream_dropped_delta = 0;
+}
+
+/// @brief Reads the summary of a midi file without building any events
+/// meant for listing large libraries, much cheaper than MidiResource::load_file
+/// @param p_path path to the .mid file
+/// @return { "format", "division", "track_count", "track_names", "note_count",
+/// "tempo_changes", "length_ticks", "duration" }, empty if the file couldn't be read
+Dictionary MidiParser::probe(const String &p_path)
+{
+    MappedFile mapped_file;
+    if (mapped_file.open(p_path))
+    {
+        return probe_bytes(mapped_file.get_bytes());
+    }
+
+    Ref<FileAccess> midi_file = FileAccess::open(p_path, FileAccess::READ);
+    if (midi_file.is_null())
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Could not open file: ") + p_path);
+        return Dictionary();
+    }
+
+    PackedByteArray midi_data = midi_file->get_buffer(midi_file->get_length());
+    return probe_bytes(Utility::as_span(midi_data));
+}
+
+/// @brief Reads the summary of a midi file held in memory, see probe
+/// @param p_bytes the whole file
+/// @return
+Dictionary MidiParser::probe_bytes(const ByteSpan &p_bytes)
+{
+    MidiProbe::Summary summary;
+    if (!MidiProbe::probe(p_bytes, summary))
+    {
+        UtilityFunctions::print("[GodotMidi] Error: Could not parse header chunk.");
+        return Dictionary();
+    }
+
+    PackedStringArray track_names;
+    for (const ByteSpan &name : summary.track_names)
+    {
+        if (name.is_empty())
+            track_names.push_back(String("Track ") + String::num_int64(track_names.size()));
+        else
+            track_names.push_back(Utility::decode_string_ascii(name));
+    }
+
+    Array tempo_array;
+    for (const TempoMap::Change &change : summary.tempo_changes)
+    {
+        Dictionary tempo_dict;
+        tempo_dict["tick"] = change.tick;
+        tempo_dict["tempo"] = change.tempo;
+        tempo_dict["time"] = summary.tempo_map.tick_to_seconds(static_cast<double>(change.tick));
+        tempo_array.push_back(tempo_dict);
+    }
+
+    Dictionary result;
+    result["format"] = summary.header.format;
+    result["division"] = summary.header.division;
+    result["track_count"] = track_names.size();
+    result["track_names"] = track_names;
+    result["note_count"] = summary.note_count;
+    result["tempo_changes"] = tempo_array;
+    result["length_ticks"] = summary.length_ticks;
+    result["duration"] = summary.duration;
+    return result;
 }
@@ -14,7 +14,11 @@
 #include <godot_cpp/classes/animation.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 #include <memory>
+#include <vector>
 #include "utility.h"
+#include "core/midi_file.h"
+#include "core/midi_track.h"
+#include "core/tempo_map.h"
 
 using namespace godot;
 
@@ -39,7 +43,8 @@ public:
     public:
         String chunk_id;
         uint32_t chunk_size;
-        PackedByteArray chunk_data;
+        // view into the loaded file buffer, the buffer must outlive the chunk
+        ByteSpan chunk_data;
         MidiChunkType chunk_type;
 
         RawMidiChunk()
@@ -49,7 +54,7 @@ public:
             chunk_type = MidiChunkType::Unknown;
         };
 
-        PackedByteArray load_from_bytes(PackedByteArray bytes);
+        ByteSpan load_from_bytes(const ByteSpan &bytes);
     };
 
     class MidiHeaderChunk
@@ -73,17 +78,15 @@ public:
         MidiDivisionType division_type;
         int32_t division;
         int32_t tempo;
-        bool end_of_track;
-        bool only_notes;
 
         MidiHeaderChunk();
-        bool parse_chunk(RawMidiChunk raw, MidiHeaderChunk &header);
+        bool parse_chunk(const RawMidiChunk &raw, MidiHeaderChunk &header);
     };
 
     class MidiChunk
     {
     public:
-        virtual bool parse_chunk(RawMidiChunk raw, MidiHeaderChunk &header) = 0;
+        virtual bool parse_chunk(const RawMidiChunk &raw, const MidiHeaderChunk &header) = 0;
     };
 
     class MidiEvent
@@ -132,7 +135,7 @@ public:
         uint8_t data;
         NoteType event_type;
 
-        MidiEventNote(int32_t channel, double delta_time, PackedByteArray data, NoteType event_type);
+        MidiEventNote(int32_t channel, double delta_time, uint8_t note, uint8_t data, NoteType event_type);
 
         MidiEventNote(const MidiEventNote &other) : MidiEvent(other)
         {
@@ -162,7 +165,7 @@ public:
 
         MidiSystemEventType event_type;
 
-        MidiEventSystem(double delta_time, PackedByteArray data);
+        MidiEventSystem(double delta_time, uint8_t status);
 
         MidiEventSystem(const MidiEventSystem &other) : MidiEvent(other)
         {
@@ -199,13 +202,14 @@ public:
         };
 
         MidiMetaEventType event_type;
-        PackedByteArray data;
+        // view into the track chunk, only valid while the file buffer is alive
+        ByteSpan data;
         int32_t event_data_length;
 
         // the actual processed data
         Variant meta_data;
 
-        MidiEventMeta(double delta_time, PackedByteArray data);
+        MidiEventMeta(double delta_time, MidiMetaEventType event_type, const ByteSpan &data);
         MidiEventMeta(const MidiEventMeta &other) : MidiEvent(other)
         {
             event_type = other.event_type;
@@ -220,7 +224,7 @@ public:
         };
     };
 
-    class MidiTrackChunk : MidiChunk
+    class MidiTrackChunk : MidiChunk, public MidiTrack
     {
     public:
         struct MidiTimeSignature
@@ -243,21 +247,11 @@ public:
             System
         };
 
-        std::vector<MidiEventNote> note_events;
-        std::vector<MidiEventMeta> meta_events;
-        std::vector<MidiEventSystem> system_events;
-        std::vector<std::unique_ptr<MidiEvent>> events;
-
         MidiTimeSignature time_signature;
         MidiKeySignature key_signature;
 
         MidiTrackChunk()
         {
-            note_events = std::vector<MidiEventNote>();
-            meta_events = std::vector<MidiEventMeta>();
-            system_events = std::vector<MidiEventSystem>();
-            events = std::vector<std::unique_ptr<MidiEvent>>();
-
             time_signature = {
                 4,
                 4,
@@ -266,9 +260,85 @@ public:
         }
 
         void IngestMetaEvent(MidiEventMeta &meta_event, MidiHeaderChunk &header);
-        bool parse_chunk(RawMidiChunk raw, MidiHeaderChunk &header);
+
+        // track chunks only read the header, so several tracks can be parsed at once
+        bool parse_chunk(const RawMidiChunk &raw, const MidiHeaderChunk &header) override;
     };
 
+    static int32_t parse_tracks(const std::vector<RawMidiChunk> &raw_tracks, const MidiHeaderChunk &header, const std::vector<EventFilter> &filters, std::vector<MidiTrackChunk> &tracks);
+
+    static void relocate_payload(MidiDecoder::Event &event, const ByteSpan &track, PackedByteArray &buffer);
+    static Dictionary make_event_dictionary(const MidiDecoder::Event &event, const ByteSpan &payloads, int32_t track_index);
+
+    static Dictionary probe(const String &p_path);
+    static Dictionary probe_bytes(const ByteSpan &p_bytes);
+
+private:
+    /// @brief What the tasks of one parse_tracks call share, owned by the call
+    struct TrackJob
+    {
+        const std::vector<RawMidiChunk> *raw_tracks;
+        const MidiHeaderChunk *header;
+        std::vector<MidiTrackChunk> *tracks;
+        // track indices, biggest track first
+        const std::vector<uint32_t> *order;
+        std::vector<uint8_t> *parsed;
+
+        void parse(uint32_t n) const;
+    };
+
+    // only set on the instance parse_tracks hands to the WorkerThreadPool
+    const TrackJob *track_job = nullptr;
+
+    void parse_track_task(uint32_t p_index);
+
+    /// @brief Where the incremental parser is in the file
+    enum StreamStage
+    {
+        WaitingForHeader,
+        WaitingForChunkHeader,
+        ReadingTrack,
+        SkippingChunk,
+        Finished
+    };
+
+    // bytes passed to feed() that haven't been consumed yet
+    std::vector<uint8_t> stream_buffer;
+    StreamStage stream_stage;
+    MidiHeaderChunk stream_header;
+    // number of bytes of the current chunk that are still to come
+    int64_t chunk_remaining;
+    int32_t stream_track;
+    // running status carried over from one poll to the next
+    MidiDecoder::State stream_state;
+    // delta time of skipped events, added to the next event of the track
+    uint32_t stream_dropped_delta;
+    // payloads of every sysex event returned by poll()
+    PackedByteArray stream_sysex_data;
+
+    int64_t poll_track(const ByteSpan &bytes, Array &events);
+
+public:
+    void feed(const PackedByteArray &p_bytes);
+    Array poll();
+    void reset();
+
+    /// @brief Gets whether every track listed in the header has been read
+    /// @return
+    inline bool is_finished() const { return stream_stage == StreamStage::Finished; }
+
+    /// @brief Gets whether the header chunk has been read, the getters below are valid after that
+    /// @return
+    inline bool has_header() const { return stream_stage != StreamStage::WaitingForHeader; }
+
+    inline int get_format() const { return stream_header.file_format; }
+    inline int get_track_count() const { return stream_header.num_tracks; }
+    inline int get_division() const { return stream_header.division; }
+
+    /// @brief Gets the payloads of the sysex events polled so far, events hold an offset and length into it
+    /// @return
+    inline PackedByteArray get_sysex_data() const { return stream_sysex_data; }
+
     MidiParser();
     ~MidiParser();
 };
@@ -1,13 +1,10 @@
 #include "midi_player.h"
 
-#define DEFAULT_MIDI_TEMPO 500000
-
 MidiPlayer::MidiPlayer()
 {
     // initialize variables
     this->current_time = 0;
-    this->prev_track_times = Array();
-    this->track_index_offsets = Array();
+    this->track_cursors = std::vector<MidiScheduler::TrackCursor>();
 
     this->speed_scale = 1;
     this->loop = false;
@@ -51,13 +48,33 @@ void MidiPlayer::play()
         return;
     }
 
-    // resize track index offsets and previous track times
-    this->track_index_offsets.resize(this->midi->get_track_count());
-    this->prev_track_times.resize(this->midi->get_track_count());
-    // set initial prev_track_times to zero
-    for (uint64_t i = 0; i < this->midi->get_track_count(); i++)
+    // lazy tracks have to be decoded before taking the snapshot, but only the ones that are played
+    if (this->tracks.is_empty())
+    {
+        this->midi->decode_all_tracks();
+    }
+    else
+    {
+        for (int64_t i = 0; i < this->tracks.size(); i++)
+        {
+            this->midi->decode_track(this->tracks[i]);
+        }
+    }
+    std::shared_ptr<const MidiResource::Snapshot> events = this->midi->get_snapshot();
+    std::atomic_store(&this->snapshot, events);
+
+    // one cursor per track, keeping the positions of a paused or seeked player
     {
-        this->prev_track_times[i] = 0;
+        std::lock_guard<std::recursive_mutex> lock(this->cursor_mutex);
+        this->track_cursors.resize(events->tracks.size());
+
+        this->routed_tracks.assign(this->tracks.is_empty() ? 0 : events->tracks.size(), 0);
+        for (int64_t i = 0; i < this->tracks.size(); i++)
+        {
+            const int32_t track = this->tracks[i];
+            if (track >= 0 && track < static_cast<int32_t>(this->routed_tracks.size()))
+                this->routed_tracks[track] = 1;
+        }
     }
 
     this->state.store(PlayerState::Playing);
@@ -92,11 +109,12 @@ void MidiPlayer::stop_internal(bool stop_asp = true)
     }
 
     // reset time to zero
-    this->current_time = 0;
-    this->prev_track_times.clear();
-    this->prev_track_times.resize(this->midi->get_track_count());
-    this->track_index_offsets.clear();
-    this->track_index_offsets.resize(this->midi->get_track_count());
+    {
+        std::lock_guard<std::recursive_mutex> lock(this->cursor_mutex);
+        this->current_time = 0;
+        this->track_cursors.assign(this->track_cursors.size(), MidiScheduler::TrackCursor());
+        this->timeline_cursor = MidiScheduler::TrackCursor();
+    }
     this->state.store(PlayerState::Stopped);
     UtilityFunctions::print("[GodotMidi] Stopped");
 
@@ -252,6 +270,7 @@ void MidiPlayer::threaded_playback()
         {
             double time = longest_asp->get_playback_position() + AudioServer::get_singleton()->get_time_since_last_mix();
             time -= audio_output_latency;
+            std::lock_guard<std::recursive_mutex> lock(this->cursor_mutex);
             delta = time - current_time;
         }
 
@@ -294,6 +313,89 @@ void MidiPlayer::loop_or_stop_thread_safe()
     UtilityFunctions::print("[GodotMidi] Finished, looping");
 }
 
+/// @brief Sets the midi resource to play, the player takes a snapshot of its events
+/// @param midi
+void MidiPlayer::set_midi(const Ref<MidiResource> &midi)
+{
+    this->midi = midi;
+    if (this->midi != NULL)
+    {
+        std::shared_ptr<const MidiResource::Snapshot> events = this->midi->get_snapshot();
+        std::atomic_store(&this->snapshot, events);
+
+        // one cursor per track
+        std::lock_guard<std::recursive_mutex> lock(this->cursor_mutex);
+        this->track_cursors.assign(events->tracks.size(), MidiScheduler::TrackCursor());
+        this->timeline_cursor = MidiScheduler::TrackCursor();
+    }
+}
+
+/// @brief Sets the current time and moves every cursor to it without firing anything
+/// every cursor is rebuilt from the event times, nothing depends on earlier playback
+/// @param current_time seconds since starting, scaled by speed_scale like playback
+void MidiPlayer::set_current_time(double current_time)
+{
+    // the playback thread may be advancing the cursors right now
+    std::lock_guard<std::recursive_mutex> lock(this->cursor_mutex);
+    this->current_time = current_time;
+    const std::shared_ptr<const MidiResource::Snapshot> events = std::atomic_load(&this->snapshot);
+    if (events == nullptr)
+        return;
+
+    const double song_time = current_time * this->speed_scale;
+
+    // seek both, use_timeline on the resource decides which one playback walks
+    const double *timeline_times = events->timeline.times.ptr();
+    const auto get_timeline_time = [&](size_t j)
+    {
+        return timeline_times[j];
+    };
+    MidiScheduler::seek(this->timeline_cursor, events->timeline.times.size(), song_time, get_timeline_time);
+
+    const int num_tracks = static_cast<int>(events->tracks.size());
+    this->track_cursors.resize(num_tracks);
+    for (int i = 0; i < num_tracks; i++)
+    {
+        const MidiResource::TrackColumns &columns = events->tracks[i];
+        const double *times = columns.times.ptr();
+
+        const auto get_event_time = [&](size_t j)
+        {
+            return times[j];
+        };
+        MidiScheduler::seek(this->track_cursors[i], columns.times.size(), song_time, get_event_time);
+    }
+}
+
+/// @brief Emits the signal of a single event
+/// @param events the snapshot being played
+/// @param track
+/// @param index index of the event inside of its track
+void MidiPlayer::fire_event(const MidiResource::Snapshot &events, int track, int64_t index)
+{
+    const MidiResource::TrackColumns &columns = events.tracks[track];
+    switch (MidiDecoder::get_status_info(columns.statuses[index]).kind)
+    {
+    case MidiDecoder::EventKind::Meta:
+        // a copy, listeners must not be able to change the events every other player shares
+        call_thread_safe("emit_signal", "meta", MidiResource::make_event(columns, track, index), track);
+        break;
+    case MidiDecoder::EventKind::Channel:
+        call_thread_safe("emit_signal", "note", MidiResource::make_event(columns, track, index), track);
+        break;
+    case MidiDecoder::EventKind::System:
+        call_thread_safe("emit_signal", "system", MidiResource::make_event(columns, track, index), track);
+        break;
+    case MidiDecoder::EventKind::SysEx:
+        // the payload lives in the resource, see MidiResource::get_sysex_payload
+        call_thread_safe("emit_signal", "sysex", MidiResource::make_event(columns, track, index), track);
+        break;
+    default:
+        UtilityFunctions::printerr("[GodotMidi] Invalid event type");
+        break;
+    }
+}
+
 /// @brief Process one delta of time for the midi player
 /// @param delta the time in seconds to process
 void MidiPlayer::process_delta(double delta)
@@ -307,102 +409,83 @@ void MidiPlayer::process_delta(double delta)
         return;
     }
 
-    // process each track
+    // held for the whole call, the resource may publish a new snapshot meanwhile
+    const std::shared_ptr<const MidiResource::Snapshot> events = std::atomic_load(&this->snapshot);
+
     bool has_more_events = false;
-    for (uint64_t i = 0; i < this->midi->get_track_count(); i++)
+    // the events that are due, fired once the lock is released so handlers can stop, seek or swap the midi
+    std::vector<std::pair<int, int64_t>> due_events;
+    // held while the cursors move, set_current_time waits for it
+    std::unique_lock<std::recursive_mutex> lock(this->cursor_mutex);
+    // event times are in song seconds, the speed scale stretches the playback clock instead
+    const double song_time = this->current_time * this->speed_scale;
+
+    if (events->use_timeline)
     {
-        // get events for this track
-        Array events = this->midi->get_tracks()[i].get("events");
+        // one cursor over every track, the cost only depends on the number of events that are due
+        const MidiResource::Timeline &timeline = events->timeline;
+        const int32_t *tracks = timeline.tracks.ptr();
+        const int32_t *track_events = timeline.events.ptr();
+        const double *times = timeline.times.ptr();
 
-        // starting at index offset, check if there's an event at the current time
-        int index_off = this->track_index_offsets[i];
-
-        // if we have more events, don't stop yet
-        if (events.size() - 1 > index_off)
+        const auto get_event_time = [&](size_t j)
         {
-            has_more_events = true;
-        }
-
-        // search forward in time
-        for (uint64_t j = index_off; j < events.size(); j++)
+            return times[j];
+        };
+        const auto fire = [&](size_t j)
         {
-            Dictionary event = events[j];
-            double event_delta = event.get("delta", 0);
-
-            // apply tempo
-            double microseconds_per_tick = static_cast<double>(this->midi->get_tempo()) / static_cast<double>(this->midi->get_division());
-            // delta time is stored as ticks, convert to microseconds
-            event_delta = event_delta * microseconds_per_tick;
+            if (is_routed(tracks[j]))
+                due_events.emplace_back(tracks[j], track_events[j]);
+        };
+        // finished at the same point as the per track path, where every track only has its last event left
+        has_more_events = static_cast<int64_t>(this->timeline_cursor.next_event) < timeline.finish_position;
+        MidiScheduler::advance(this->timeline_cursor, timeline.times.size(), song_time, get_event_time, fire);
+    }
+    else
+    {
+        // process each track
+        const int num_tracks = static_cast<int>(events->tracks.size());
+        this->track_cursors.resize(num_tracks);
+        for (int i = 0; i < num_tracks; i++)
+        {
+            if (!is_routed(i))
+                continue;
 
-            // convert to seconds for ease of use
-            double event_delta_seconds = event_delta / 1000000.0;
-            event_delta_seconds /= speed_scale;
-            double event_absolute_time = event_delta_seconds + static_cast<double>(this->prev_track_times[i]);
+            // tempo changes are already part of the event times
+            const MidiResource::TrackColumns &columns = events->tracks[i];
+            const double *times = columns.times.ptr();
 
-            if (this->current_time >= event_absolute_time)
+            const auto get_event_time = [&](size_t j)
             {
-                // start at next available event (index offset + 1, since index offset is the last event we processed)
-                this->track_index_offsets[i] = j + 1;
-                String event_type = event.get("type", "undef");
-
-                if (event_type == "meta")
-                {
-                    // print note index offset, time, j and absolute time, track, subtype and delta
-                    // UtilityFunctions::print("Note index offset: " + String::num_int64(index_off) + " j: " + String::num_int64(j) + " Time: " + String::num(this->current_time) + " Absolute time: " + String::num(event_absolute_time) + " Track: " + String::num_int64(i) + " Subtype: " + String::num(event.get("subtype", 0)) + " Delta: " + String::num(event_delta_seconds));
-
-                    // ingest meta events such as tempo changes
-                    // we need to do this now as opposed to when the midi file is loaded
-                    // to allow for tempo changes during playback
-                    int meta_type = event.get("subtype", 0);
-
-                    if (meta_type == MidiParser::MidiEventMeta::MidiMetaEventType::SetTempo)
-                    {
-                        this->midi->set_tempo(static_cast<int>(event.get("data", DEFAULT_MIDI_TEMPO)));
-
-                        // print tempo
-                        // UtilityFunctions::print("[GodotMidi] Tempo: " + String::num(this->midi->get_tempo()));
-                    }
-
-                    // TODO: support time signature changes
-                    // these should be handled in the same way as tempo changes
-                    // to allow for changes during playback (even though it isn't usually necessary)
-
-                    call_thread_safe("emit_signal", "meta", event, i);
-                }
-                else if (event_type == "note")
-                {
-                    call_thread_safe("emit_signal", "note", event, i);
-                    // print note index offset, time, j, absolute time, track, subtype and delta
-                    // UtilityFunctions::print("Note index offset: " + String::num_int64(index_off) + " j: " + String::num_int64(j) + " Time: " + String::num(this->current_time) + " Absolute time: " + String::num(event_absolute_time) + " Track: " + String::num_int64(i) + " Subtype: " + String::num(event.get("subtype", 0)) + " Delta: " + String::num(event_delta_seconds));
-                }
-                else if (event_type == "system")
-                {
-                    call_thread_safe("emit_signal", "system", event, i);
-                }
-                else
-                {
-                    UtilityFunctions::printerr("[GodotMidi] Invalid event type");
-                }
-
-                // store time to look for events after this one
-                this->prev_track_times[i] = event_absolute_time;
-            }
-            else
+                return times[j];
+            };
+            const auto fire = [&](size_t j)
+            {
+                due_events.emplace_back(i, static_cast<int64_t>(j));
+            };
+
+            // if we have more events, don't stop yet
+            if (MidiScheduler::advance(this->track_cursors[i], columns.times.size(), song_time, get_event_time, fire))
             {
-                // print
-                // UtilityFunctions::print("[GodotMidi] No more events on this track at this time");
-                // we've gone too far, break and move to the next track
-                break;
+                has_more_events = true;
             }
         }
     }
 
+    // increment time, current time will hold the
+    // number of seconds since starting
+    this->current_time += delta;
+    lock.unlock();
+
+    // in the order the cursors reached them: by time on the timeline, track after track otherwise
+    for (const std::pair<int, int64_t> &due : due_events)
+    {
+        fire_event(*events, due.first, due.second);
+    }
+
+    // stopping resets the cursors and joins the playback thread, so it can't run under the lock
     if (has_more_events == false)
     {
         loop_or_stop_thread_safe();
     }
-
-    // increment time, current time will hold the
-    // number of seconds since starting
-    this->current_time += delta;
-}
\ No newline at end of file
+}
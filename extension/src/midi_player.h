@@ -19,10 +19,15 @@
 #include <godot_cpp/classes/scene_tree.hpp>
 #include <godot_cpp/classes/audio_stream.hpp>
 
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "midi_resource.h"
 #include "midi_parser.h"
+#include "core/midi_scheduler.h"
 
 using namespace godot;
 
@@ -67,6 +72,10 @@ protected:
         ClassDB::bind_method(D_METHOD("set_auto_stop", "auto_stop"), &MidiPlayer::set_auto_stop);
         ADD_PROPERTY(PropertyInfo(Variant::BOOL, "auto_stop"), "set_auto_stop", "get_auto_stop");
 
+        ClassDB::bind_method(D_METHOD("get_tracks"), &MidiPlayer::get_tracks);
+        ClassDB::bind_method(D_METHOD("set_tracks", "tracks"), &MidiPlayer::set_tracks);
+        ADD_PROPERTY(PropertyInfo(Variant::PACKED_INT32_ARRAY, "tracks"), "set_tracks", "get_tracks");
+
         ClassDB::bind_method(D_METHOD("link_audio_stream_player", "audio_stream_player"), &MidiPlayer::link_audio_stream_player);
 
         ClassDB::bind_method(D_METHOD("process_delta", "delta"), &MidiPlayer::process_delta);
@@ -79,6 +88,7 @@ protected:
         ADD_SIGNAL(MethodInfo("note"));
         ADD_SIGNAL(MethodInfo("meta"));
         ADD_SIGNAL(MethodInfo("system"));
+        ADD_SIGNAL(MethodInfo("sysex"));
     };
 
 private:
@@ -91,8 +101,24 @@ private:
     /// @brief The current time in seconds
     double current_time;
 
-    /// @brief The current track index offsets
-    Array track_index_offsets;
+    /// @brief The events being played, shared with every other player of the resource and never modified
+    /// swapped with std::atomic_load/atomic_store since the playback thread reads it
+    std::shared_ptr<const MidiResource::Snapshot> snapshot;
+
+    /// @brief Guards the cursors and current_time, which the playback thread moves while seeks and stops reset them
+    /// events are never emitted while it's held, recursive so a handler that still ends up inside of it can't deadlock
+    std::recursive_mutex cursor_mutex;
+
+    /// @brief The playback position in each track
+    std::vector<MidiScheduler::TrackCursor> track_cursors;
+    /// @brief The playback position in the merged timeline, used instead of track_cursors when the resource has one
+    MidiScheduler::TrackCursor timeline_cursor;
+
+    /// @brief The tracks to play, every track of the resource when empty
+    PackedInt32Array tracks;
+    /// @brief Whether each track of the snapshot is played, every track when empty
+    /// built from tracks by play() and guarded by cursor_mutex
+    std::vector<uint8_t> routed_tracks;
 
     /// @brief Whether to loop the midi playback
     bool loop;
@@ -100,9 +126,6 @@ private:
     /// @brief The speed scale of the midi playback (1.0 = normal speed, 2.0 = double speed, 0.5 = half speed, etc.)
     double speed_scale;
 
-    /// @brief Track previous time for delta calculation
-    Array prev_track_times;
-    
     /// @brief The linked AudioStreamPlayer (optional)
     std::vector<AudioStreamPlayer*> asps;
     AudioStreamPlayer* longest_asp;
@@ -123,6 +146,14 @@ private:
 
     void loop_or_stop_thread_safe();
 
+    void fire_event(const MidiResource::Snapshot &events, int track, int64_t index);
+
+    /// @brief Checks if the events of a track are played, call with cursor_mutex held
+    bool is_routed(int track) const
+    {
+        return routed_tracks.empty() || (track >= 0 && track < static_cast<int>(routed_tracks.size()) && routed_tracks[track]);
+    };
+
 public:
     void process_delta(double delta);
 
@@ -182,60 +213,22 @@ public:
         this->loop = loop;
     };
 
-    /// @brief Sets the current time and updates the track index offsets
-    /// @param current_time 
-    void set_current_time(double current_time)
+    PackedInt32Array get_tracks()
     {
-        this->current_time = current_time;
-
-        // update track_index_offsets
-        for (uint64_t i = 0; i < this->midi->get_track_count(); i++)
-        {
-            // get events for this track
-            Array events = this->midi->get_tracks()[i].get("events");
-
-            // search forward in time
-            for (uint64_t j = 0; j < events.size(); j++)
-            {
-                Dictionary event = events[j];
-                double event_delta = event.get("delta", 0);
-
-                // apply tempo
-                double microseconds_per_tick = static_cast<double>(this->midi->get_tempo()) / static_cast<double>(this->midi->get_division());
-                // delta time is stored as ticks, convert to microseconds
-                event_delta = event_delta * microseconds_per_tick;
-
-                // convert to seconds for ease of use
-                double event_delta_seconds = event_delta / 1000000.0;
-                double event_absolute_time = event_delta_seconds + static_cast<double>(this->prev_track_times[i]);
-
-                // update the offset if the event time is less than the current time
-                if (this->current_time >= event_absolute_time)
-                {
-                    this->track_index_offsets[i] = j;
-                }
-                else
-                {
-                    break;
-                }
-
-                // update the previous track time
-                this->prev_track_times[i] = event_absolute_time;
-            }
-        }
+        return this->tracks;
     };
 
-    void set_midi(const Ref<MidiResource> &midi)
+    /// @brief Sets the tracks to play, takes effect the next time the player starts
+    /// only these tracks are decoded when the resource was loaded with lazy_tracks
+    void set_tracks(const PackedInt32Array &tracks)
     {
-        this->midi = midi;
-        if (this->midi != NULL)
-        {
-            // initialize track_index_offsets
-            this->track_index_offsets.clear();
-            this->track_index_offsets.resize(this->midi->get_track_count());
-        }
+        this->tracks = tracks;
     };
 
+    void set_current_time(double current_time);
+
+    void set_midi(const Ref<MidiResource> &midi);
+
     Ref<MidiResource> get_midi()
     {
         return this->midi;
@@ -1,10 +1,40 @@
 #include "midi_resource.h"
 
 #include "midi_parser.h"
+#include "mapped_file.h"
+#include "core/parse_diagnostics.h"
+#include "core/controller_decimator.h"
 
-Error MidiResource::load_file(const String &p_path)
+/// @brief Loads and parses a midi file into this resource
+/// @param p_path path to the .mid file
+/// @param p_options events to leave out, they're dropped while decoding:
+/// "drop_meta", "drop_system" (system and sysex), "drop_controllers", "drop_pitch_bend", "drop_aftertouch" as bools,
+/// "channels" and "tracks" as arrays of the channels and tracks to keep (empty keeps all),
+/// tempo changes and end of track events are always kept.
+/// "decimate_controllers" thins out dense controller and pitch bend streams, see ControllerDecimator,
+/// with "controller_tolerance", "pitch_bend_tolerance" (14 bit) and "decimate_min_interval" (seconds)
+/// @return
+Error MidiResource::load_file(const String &p_path, const Dictionary &p_options)
 {
+    if (!check_idle())
+        return ERR_BUSY;
+
+    // memory mapped path, the OS pages the file in as the parser reaches it
+    if (this->use_memory_map)
+    {
+        MappedFile mapped_file;
+        if (mapped_file.open(p_path))
+        {
+            UtilityFunctions::print(String("[GodotMidi] Reading midi file data (memory mapped): ") + p_path);
+            this->last_load_mode = LOAD_MODE_MEMORY_MAPPED;
+
+            // the mapping stays alive until parsing is done
+            return parse_bytes(mapped_file.get_bytes(), p_options);
+        }
+    }
+
     UtilityFunctions::print(String("[GodotMidi] Reading midi file data: ") + p_path);
+    this->last_load_mode = LOAD_MODE_BUFFERED;
 
     // get midi file data
     godot::Ref<godot::FileAccess> midi_file = FileAccess::open(p_path, FileAccess::READ);
@@ -17,9 +47,430 @@ Error MidiResource::load_file(const String &p_path)
     PackedByteArray midi_data = midi_file->get_buffer(midi_file->get_length());
     // file will be auto-closed when midi_file goes out of scope
 
+    // every chunk and event is decoded through views of this one buffer,
+    // so midi_data must stay alive (and unmodified) until parsing is done
+    return parse_bytes(Utility::as_span(midi_data), p_options);
+}
+
+/// @brief Loads a midi file like load_file, but reuses the binary form of an earlier load when
+/// neither the file nor the options changed, the result is never lazy
+/// the cache entry is named after a hash of the path followed by a SHA-256 of the binary format and import versions,
+/// the options and the file, writing an entry removes the older entries of the same path
+/// @param p_path path to the .mid file
+/// @param p_options see load_file
+/// @param p_cache_dir directory the binary forms are kept in, created if needed
+/// @return
+Error MidiResource::load_file_cached(const String &p_path, const Dictionary &p_options, const String &p_cache_dir)
+{
+    if (!check_idle())
+        return ERR_BUSY;
+
+    godot::Ref<godot::FileAccess> midi_file = FileAccess::open(p_path, FileAccess::READ);
+    if (midi_file.is_null())
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Could not open file: ") + p_path);
+        return FAILED;
+    }
+    // read once, the same buffer is hashed and, on a miss, parsed
+    PackedByteArray midi_data = midi_file->get_buffer(midi_file->get_length());
+
+    // options are hashed in key order, the same options in another order give the same entry
+    Array keys = p_options.keys();
+    keys.sort();
+    String options_text = "version=" + String::num_int64(BINARY_VERSION) + "\n";
+    options_text += "import=" + String::num_int64(IMPORT_CACHE_VERSION) + "\n";
+    for (int64_t i = 0; i < keys.size(); i++)
+    {
+        options_text += UtilityFunctions::var_to_str(keys[i]) + "=" + UtilityFunctions::var_to_str(p_options[keys[i]]) + "\n";
+    }
+
+    Ref<HashingContext> hashing;
+    hashing.instantiate();
+    hashing->start(HashingContext::HASH_SHA256);
+    hashing->update(options_text.to_utf8_buffer());
+    hashing->update(midi_data);
+    // the path prefix finds the entries an edit of the file or its options left behind
+    const String path_prefix = p_path.md5_text() + "-";
+    const String cache_name = path_prefix + hashing->finish().hex_encode() + "." + BINARY_EXTENSION;
+    const String cache_path = p_cache_dir.path_join(cache_name);
+
+    if (FileAccess::file_exists(cache_path) && load_binary(cache_path) == OK)
+    {
+        UtilityFunctions::print(String("[GodotMidi] Reusing cached import of ") + p_path + ": " + cache_path);
+        this->last_load_mode = LOAD_MODE_BUFFERED;
+        return OK;
+    }
+
+    UtilityFunctions::print(String("[GodotMidi] Reading midi file data: ") + p_path);
+    this->last_load_mode = LOAD_MODE_BUFFERED;
+    const bool was_lazy = this->lazy_tracks;
+    this->lazy_tracks = false;
+    Error err = parse_bytes(Utility::as_span(midi_data), p_options);
+    this->lazy_tracks = was_lazy;
+    if (err != OK)
+        return err;
+
+    // a missing cache only costs time on the next import
+    DirAccess::make_dir_recursive_absolute(p_cache_dir);
+    if (write_binary(cache_path) != OK)
+    {
+        UtilityFunctions::push_warning(String("[GodotMidi] Could not write the import cache: ") + cache_path);
+        return OK;
+    }
+
+    // only the newest entry of a file is kept
+    const PackedStringArray cached_files = DirAccess::get_files_at(p_cache_dir);
+    for (int64_t i = 0; i < cached_files.size(); i++)
+    {
+        const String cached_file = cached_files[i];
+        if (cached_file != cache_name && cached_file.begins_with(path_prefix) && cached_file.get_extension() == BINARY_EXTENSION)
+        {
+            DirAccess::remove_absolute(p_cache_dir.path_join(cached_file));
+        }
+    }
+    return OK;
+}
+
+/// @brief Starts loading a midi file like load_file on the WorkerThreadPool
+/// the resource keeps its current contents while the file is parsed, "load_progress" is emitted as the
+/// parse advances and "load_completed" once the new contents replaced the old ones, both on the main thread
+/// @param p_path path to the .mid file
+/// @param p_options see load_file
+/// @return ERR_BUSY if a load is already running
+Error MidiResource::load_file_async(const String &p_path, const Dictionary &p_options)
+{
+    // one load at a time, the second one is rejected rather than queued
+    bool expected = false;
+    if (!this->loading.compare_exchange_strong(expected, true))
+    {
+        UtilityFunctions::printerr("[GodotMidi] A midi file is already being loaded into this resource");
+        return ERR_BUSY;
+    }
+
+    this->load_owner = Ref<MidiResource>(this);
+    this->load_task_id = WorkerThreadPool::get_singleton()->add_task(
+        callable_mp(this, &MidiResource::load_async_internal).bind(p_path, p_options), false, String("[GodotMidi] Loading ") + p_path);
+    return OK;
+}
+
+/// @brief Runs on a worker thread, parses the file into a new resource and hands it to the main thread
+/// @param p_path
+/// @param p_options
+void MidiResource::load_async_internal(const String &p_path, const Dictionary &p_options)
+{
+    Ref<MidiResource> staging;
+    staging.instantiate();
+    staging->use_memory_map = this->use_memory_map;
+    staging->lazy_tracks = this->lazy_tracks;
+    staging->use_timeline = this->use_timeline;
+    staging->progress_target = this;
+
+    Error err = staging->load_file(p_path, p_options);
+    staging->progress_target = nullptr;
+
+    // the main thread only reads it after the call below is dispatched
+    this->pending_load = staging;
+    callable_mp(this, &MidiResource::finish_load_internal).call_deferred(err);
+}
+
+/// @brief Runs on the main thread once the worker is done, takes over the parsed contents
+/// @param p_error the result of the parse, the current contents are kept when it failed
+void MidiResource::finish_load_internal(Error p_error)
+{
+    WorkerThreadPool::get_singleton()->wait_for_task_completion(this->load_task_id);
+    this->load_task_id = -1;
+
+    // released when this returns, a load_completed listener may already start the next load
+    Ref<MidiResource> owner = this->load_owner;
+    this->load_owner.unref();
+
+    if (p_error == OK)
+    {
+        adopt(*this->pending_load.ptr());
+        emit_changed();
+    }
+    this->pending_load.unref();
+    this->loading = false;
+
+    emit_signal("load_completed", p_error);
+}
+
+/// @brief Checks that no load_file_async is running, its result would replace whatever is loaded meanwhile
+/// @return
+bool MidiResource::check_idle() const
+{
+    if (this->loading.load())
+    {
+        UtilityFunctions::printerr("[GodotMidi] A midi file is already being loaded into this resource");
+        return false;
+    }
+    return true;
+}
+
+/// @brief Emits "load_progress" when this resource is being parsed for a load_file_async
+/// @param p_fraction how much of the load is done, from 0 to 1
+void MidiResource::report_progress(double p_fraction)
+{
+    if (this->progress_target != nullptr)
+    {
+        this->progress_target->call_thread_safe("emit_signal", "load_progress", p_fraction);
+    }
+}
+
+/// @brief Takes over everything another resource loaded, players pick up the new events the next time they play
+/// @param p_other a resource that's done loading, it's left empty
+void MidiResource::adopt(MidiResource &p_other)
+{
+    this->format = p_other.format;
+    this->track_count = p_other.track_count;
+    this->division = p_other.division;
+    this->tempo = p_other.tempo;
+    this->tracks = p_other.tracks;
+    this->tracks_built = p_other.tracks_built;
+    this->sysex_data = p_other.sysex_data;
+    this->track_columns = std::move(p_other.track_columns);
+    this->meta_payloads = p_other.meta_payloads;
+    this->has_meta_payloads = p_other.has_meta_payloads;
+    this->tempo_map = std::move(p_other.tempo_map);
+    this->timeline = p_other.timeline;
+    this->note_index = std::move(p_other.note_index);
+    this->note_columns = p_other.note_columns;
+    this->decimate_controllers = p_other.decimate_controllers;
+    this->decimation = p_other.decimation;
+    this->last_load_mode = p_other.last_load_mode;
+    this->parse_allocation_count = p_other.parse_allocation_count;
+    this->diagnostics = p_other.diagnostics;
+    this->timeline_stale = p_other.timeline_stale;
+    this->notes_stale = p_other.notes_stale;
+
+    // one swap, a player sees either all of the old events or all of the new ones
+    this->snapshot = std::move(p_other.snapshot);
+}
+
+/// @brief Converts parse diagnostics into the dictionary returned by get_diagnostics
+/// @param p_diagnostics
+/// @return { category: { "count": int, "offsets": PackedInt64Array }, ..., "bytes_skipped": int }
+static Dictionary diagnostics_to_dictionary(const ParseDiagnostics &p_diagnostics)
+{
+    Dictionary result;
+    for (int c = 0; c < ParseDiagnostics::CategoryCount; c++)
+    {
+        const ParseDiagnostics::CategoryInfo &info = p_diagnostics.get_category((ParseDiagnostics::Category)c);
+        PackedInt64Array offsets;
+        for (uint32_t i = 0; i < info.count && i < ParseDiagnostics::MAX_OFFSETS; i++)
+        {
+            offsets.push_back(info.offsets[i]);
+        }
+
+        Dictionary category;
+        category["count"] = info.count;
+        category["offsets"] = offsets;
+        result[ParseDiagnostics::get_category_name((ParseDiagnostics::Category)c)] = category;
+    }
+    result["bytes_skipped"] = p_diagnostics.get_bytes_skipped();
+    return result;
+}
+
+/// @brief Formats the non zero counters of parse diagnostics into a single line
+/// @param p_diagnostics
+/// @return
+static String diagnostics_summary(const ParseDiagnostics &p_diagnostics)
+{
+    String summary = "Parse issues:";
+    for (int c = 0; c < ParseDiagnostics::CategoryCount; c++)
+    {
+        const ParseDiagnostics::CategoryInfo &info = p_diagnostics.get_category((ParseDiagnostics::Category)c);
+        if (info.count == 0)
+            continue;
+
+        summary += String(" ") + ParseDiagnostics::get_category_name((ParseDiagnostics::Category)c) + " x" + String::num_int64(info.count) + " (first at byte " + String::num_int64(info.offsets[0]) + "),";
+    }
+    return summary + " " + String::num_int64(p_diagnostics.get_bytes_skipped()) + " bytes skipped.";
+}
+
+/// @brief Copies the decoded events of a track into its packed columns
+/// @param p_track the decoded track, its data must still be alive
+/// @param p_columns [out] the deltas, statuses, data and payload columns, the name if the track has one
+/// @param p_meta_payloads [out] meta payloads are appended to it, the columns point into it
+/// @param p_sysex_data [out] sysex payloads are appended to it, the columns point into it
+static void fill_columns(const MidiTrack &p_track, MidiResource::TrackColumns &p_columns, PackedByteArray &p_meta_payloads, PackedByteArray &p_sysex_data)
+{
+    const MidiEventStore &store = p_track.events;
+    const int64_t capacity = static_cast<int64_t>(store.size());
+    p_columns.deltas.resize(capacity);
+    p_columns.statuses.resize(capacity);
+    p_columns.data1.resize(capacity);
+    p_columns.data2.resize(capacity);
+    p_columns.payload_offsets.resize(capacity);
+    p_columns.payload_lengths.resize(capacity);
+
+    int32_t *deltas = p_columns.deltas.ptrw();
+    uint8_t *statuses = p_columns.statuses.ptrw();
+    uint8_t *data1 = p_columns.data1.ptrw();
+    uint8_t *data2 = p_columns.data2.ptrw();
+    int32_t *payload_offsets = p_columns.payload_offsets.ptrw();
+    int32_t *payload_lengths = p_columns.payload_lengths.ptrw();
+
+    // one linear sweep over the event columns
+    int64_t num_events = 0;
+    for (size_t i = 0; i < store.size(); i++)
+    {
+        MidiDecoder::Event event = store.get_event(i);
+        if (event.kind == MidiDecoder::EventKind::Unknown)
+            continue;
+
+        if (event.kind == MidiDecoder::EventKind::Meta)
+        {
+            MidiParser::relocate_payload(event, p_track.data, p_meta_payloads);
+
+            // if we have a track name event, update the track name
+            if (event.meta_type == MidiParser::MidiEventMeta::MidiMetaEventType::SequenceOrTrackName)
+            {
+                p_columns.name = Utility::decode_string_ascii(Utility::as_span(p_meta_payloads).slice(event.payload_offset, event.payload_offset + event.payload_length));
+            }
+        }
+        else if (event.kind == MidiDecoder::EventKind::SysEx)
+        {
+            MidiParser::relocate_payload(event, p_track.data, p_sysex_data);
+        }
+
+        deltas[num_events] = static_cast<int32_t>(event.delta);
+        statuses[num_events] = event.status;
+        data1[num_events] = event.kind == MidiDecoder::EventKind::Meta ? event.meta_type : event.data1;
+        data2[num_events] = event.data2;
+        payload_offsets[num_events] = static_cast<int32_t>(event.payload_offset);
+        payload_lengths[num_events] = static_cast<int32_t>(event.payload_length);
+        num_events++;
+    }
+
+    p_columns.deltas.resize(num_events);
+    p_columns.statuses.resize(num_events);
+    p_columns.data1.resize(num_events);
+    p_columns.data2.resize(num_events);
+    p_columns.payload_offsets.resize(num_events);
+    p_columns.payload_lengths.resize(num_events);
+}
+
+/// @brief Reads what a lazy track contributes to the whole song without storing its events
+/// the payloads are copied in the same order fill_columns copies them, so decoding the
+/// track later only has to shift its payload offsets by the recorded bases
+/// @param p_data the contents of the MTrk chunk
+/// @param p_columns [out] the name, tempo changes, payload bases and source bytes, its filter is applied
+/// @param p_meta_payloads [out] meta payloads are appended to it
+/// @param p_sysex_data [out] sysex payloads are appended to it
+/// @param p_diagnostics [out] offsets are relative to the start of the track data
+static void scan_track(const ByteSpan &p_data, MidiResource::TrackColumns &p_columns, PackedByteArray &p_meta_payloads, PackedByteArray &p_sysex_data, ParseDiagnostics &p_diagnostics)
+{
+    p_columns.meta_payload_base = p_meta_payloads.size();
+    p_columns.sysex_payload_base = p_sysex_data.size();
+    p_columns.tempo_changes.clear();
+
+    int64_t tick = 0;
+    const auto sink = [&](const MidiDecoder::Event &event)
+    {
+        tick += event.delta;
+        // only the payloads of kept events are copied, the same ones decoding copies
+        if (event.kind != MidiDecoder::EventKind::Unknown && !p_columns.filter.accepts(event))
+            return true;
+
+        MidiDecoder::Event relocated = event;
+        switch (event.kind)
+        {
+        case MidiDecoder::EventKind::Meta:
+        {
+            MidiParser::relocate_payload(relocated, p_data, p_meta_payloads);
+            ByteSpan payload = Utility::as_span(p_meta_payloads).slice(relocated.payload_offset, relocated.payload_offset + relocated.payload_length);
+            if (event.meta_type == MidiParser::MidiEventMeta::MidiMetaEventType::SequenceOrTrackName)
+                p_columns.name = Utility::decode_string_ascii(payload);
+            else if (event.meta_type == MidiParser::MidiEventMeta::MidiMetaEventType::SetTempo && payload.size >= 3)
+                p_columns.tempo_changes.push_back({static_cast<int32_t>(tick), Utility::decode_int24_be(payload, 0)});
+            break;
+        }
+        case MidiDecoder::EventKind::SysEx:
+            MidiParser::relocate_payload(relocated, p_data, p_sysex_data);
+            break;
+        case MidiDecoder::EventKind::Unknown:
+            p_diagnostics.report(event.status & 0x80 ? ParseDiagnostics::UnknownEvent : ParseDiagnostics::StrayDataByte, event.offset, 1);
+            break;
+        default:
+            break;
+        }
+        return true;
+    };
+    const MidiDecoder::Validation validation = MidiDecoder::decode_checked(p_data, sink);
+    MidiTrack::report_damage(validation, p_data.size, p_diagnostics);
+
+    // only the part before the damage is kept, decoding it again gives the same events
+    p_columns.source.resize(validation.end_offset);
+    if (validation.end_offset > 0)
+        memcpy(p_columns.source.ptrw(), p_data.data, validation.end_offset);
+    p_columns.lazy = true;
+    p_columns.decoded = false;
+}
+
+/// @brief Reads an option of load_file that lists channels or tracks
+/// @param p_options
+/// @param p_name
+/// @return empty if the option is missing
+static PackedInt32Array int_array_option(const Dictionary &p_options, const char *p_name)
+{
+    // arrays written in GDScript are untyped
+    Variant value = p_options.get(p_name, Variant());
+    if (value.get_type() == Variant::ARRAY)
+        return PackedInt32Array(static_cast<Array>(value));
+    if (value.get_type() == Variant::PACKED_INT32_ARRAY)
+        return value;
+    return PackedInt32Array();
+}
+
+/// @brief Reads the options of load_file that apply to every track
+/// @param p_options
+/// @return
+static EventFilter filter_from_options(const Dictionary &p_options)
+{
+    EventFilter filter;
+    const auto drop = [&](const char *p_name, uint16_t p_categories)
+    {
+        if (static_cast<bool>(p_options.get(p_name, false)))
+            filter.categories &= ~p_categories;
+    };
+    drop("drop_meta", EventFilter::Meta);
+    drop("drop_system", EventFilter::System | EventFilter::SysEx);
+    drop("drop_controllers", EventFilter::Controllers);
+    drop("drop_pitch_bend", EventFilter::PitchBend);
+    drop("drop_aftertouch", EventFilter::Aftertouch);
+
+    PackedInt32Array channels = int_array_option(p_options, "channels");
+    if (!channels.is_empty())
+    {
+        filter.channels = 0;
+        for (int64_t i = 0; i < channels.size(); i++)
+        {
+            if (channels[i] >= 0 && channels[i] < 16)
+                filter.channels |= static_cast<uint16_t>(1 << channels[i]);
+        }
+    }
+    return filter;
+}
+
+/// @brief Parses the contents of a midi file into this resource
+/// @param p_bytes the whole file, must stay valid for the duration of the call
+/// @param p_options see load_file
+/// @return
+Error MidiResource::parse_bytes(const ByteSpan &p_bytes, const Dictionary &p_options)
+{
+    ByteSpan remaining = p_bytes;
+    this->diagnostics.clear();
+
+    // lazy tracks are thinned when they're decoded, so the settings are kept
+    this->decimate_controllers = p_options.get("decimate_controllers", false);
+    this->decimation.controller_tolerance = p_options.get("controller_tolerance", 0);
+    this->decimation.pitch_bend_tolerance = p_options.get("pitch_bend_tolerance", 0);
+    this->decimation.min_interval = p_options.get("decimate_min_interval", 0.0);
+
     // read header chunk
     MidiParser::RawMidiChunk header_chunk;
-    midi_data = header_chunk.load_from_bytes(midi_data);
+    remaining = header_chunk.load_from_bytes(remaining);
 
     // parse header chunk
     MidiParser::MidiHeaderChunk header;
@@ -29,118 +480,1408 @@ Error MidiResource::load_file(const String &p_path)
         return FAILED;
     }
 
-    header.only_notes = false;
-
     // load header into resource
     this->format = header.file_format;
     this->track_count = header.num_tracks;
     this->division = header.division;
     this->tempo = header.tempo;
+    this->sysex_data.clear();
+
+    // offsets in the diagnostics are relative to the start of the file
+    ParseDiagnostics parse_diagnostics;
+
+    // first pass: find the track chunk boundaries, this only reads chunk headers
+    std::vector<MidiParser::RawMidiChunk> raw_tracks;
+    raw_tracks.reserve(header.num_tracks);
+    while (!remaining.is_empty() && static_cast<int32_t>(raw_tracks.size()) < header.num_tracks)
+    {
+        int64_t chunk_offset = remaining.data - p_bytes.data;
+        MidiParser::RawMidiChunk track_chunk;
+        remaining = track_chunk.load_from_bytes(remaining);
+
+        // unknown chunks are skipped per the midi specification
+        if (track_chunk.chunk_type == MidiParser::MidiChunkType::Track)
+        {
+            raw_tracks.push_back(track_chunk);
+        }
+        else
+        {
+            parse_diagnostics.report(ParseDiagnostics::UnknownChunk, chunk_offset, (remaining.data - p_bytes.data) - chunk_offset);
+        }
+    }
+
+    for (int32_t i = static_cast<int32_t>(raw_tracks.size()); i < header.num_tracks; i++)
+    {
+        parse_diagnostics.report(ParseDiagnostics::MissingTrack, p_bytes.size);
+    }
+    this->track_count = static_cast<int>(raw_tracks.size());
+    // progress of a load_file_async: the chunk headers are read, decoding takes most of the rest
+    report_progress(0.1);
+
+    // tracks that weren't chosen still give the tempo map their tempo changes
+    std::vector<EventFilter> filters(raw_tracks.size(), filter_from_options(p_options));
+    PackedInt32Array selected_tracks = int_array_option(p_options, "tracks");
+    if (!selected_tracks.is_empty())
+    {
+        for (int32_t trk_idx = 0; trk_idx < static_cast<int32_t>(filters.size()); trk_idx++)
+        {
+            if (!selected_tracks.has(trk_idx))
+                filters[trk_idx].categories = 0;
+        }
+    }
 
-    for (int trk_idx = 0; trk_idx < header.num_tracks; ++trk_idx)
+    this->track_columns.clear();
+    this->track_columns.resize(raw_tracks.size());
+    this->meta_payloads.clear();
+    this->parse_allocation_count = 0;
+    for (int trk_idx = 0; trk_idx < static_cast<int>(raw_tracks.size()); ++trk_idx)
     {
-        // read track chunk
-        MidiParser::RawMidiChunk trackChunk;
-        midi_data = trackChunk.load_from_bytes(midi_data);
+        this->track_columns[trk_idx].name = String("Track ") + String::num_int64(trk_idx);
+    }
 
-        // parse track chunk
-        MidiParser::MidiTrackChunk track;
-        if (!track.parse_chunk(trackChunk, header))
+    if (this->lazy_tracks)
+    {
+        // second pass: only what the whole song needs (names, payloads, tempo changes),
+        // the columns of a track are decoded when it's first used
+        for (int trk_idx = 0; trk_idx < static_cast<int>(raw_tracks.size()); ++trk_idx)
+        {
+            const ByteSpan &track_data = raw_tracks[trk_idx].chunk_data;
+            ParseDiagnostics track_diagnostics;
+            this->track_columns[trk_idx].filter = filters[trk_idx];
+            scan_track(track_data, this->track_columns[trk_idx], this->meta_payloads, this->sysex_data, track_diagnostics);
+            parse_diagnostics.merge(track_diagnostics, track_data.data - p_bytes.data);
+            report_progress(0.1 + 0.7 * (trk_idx + 1) / raw_tracks.size());
+        }
+    }
+    else
+    {
+        // second pass: decode the tracks in parallel
+        std::vector<MidiParser::MidiTrackChunk> parsed_tracks;
+        int32_t failed_track = MidiParser::parse_tracks(raw_tracks, header, filters, parsed_tracks);
+        if (failed_track >= 0)
         {
-            UtilityFunctions::print("[GodotMidi] Error: Could not parse track chunk: " + String::num_int64(trk_idx));
+            UtilityFunctions::print("[GodotMidi] Error: Could not parse track chunk: " + String::num_int64(failed_track));
             return FAILED;
         }
+        report_progress(0.6);
 
-        // add track
-        Dictionary track_dict;
-        track_dict["name"] = String("Track ") + String::num_int64(trk_idx);
-        track_dict["events"] = Array();
+        for (const MidiParser::MidiTrackChunk &track : parsed_tracks)
+        {
+            this->parse_allocation_count += static_cast<int64_t>(track.arena->get_heap_allocation_count());
+            parse_diagnostics.merge(track.diagnostics, track.data.data - p_bytes.data);
+        }
 
-        this->tracks.push_back(track_dict);
+        // finally copy the tracks into packed columns in file order, the payloads
+        // are copied too so nothing points into the file data after this
+        for (int trk_idx = 0; trk_idx < static_cast<int>(parsed_tracks.size()); ++trk_idx)
+        {
+            fill_columns(parsed_tracks[trk_idx], this->track_columns[trk_idx], this->meta_payloads, this->sysex_data);
+            report_progress(0.6 + 0.2 * (trk_idx + 1) / parsed_tracks.size());
+        }
+    }
+
+    // one summary instead of a line per problem
+    this->diagnostics = diagnostics_to_dictionary(parse_diagnostics);
+    if (parse_diagnostics.has_issues())
+    {
+        UtilityFunctions::print("[GodotMidi] Warning: " + diagnostics_summary(parse_diagnostics));
+    }
+
+    this->has_meta_payloads = true;
+    for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
+    {
+        index_track(trk_idx);
+    }
+    build_tempo_map();
+    report_progress(0.9);
 
-        // loop through events
-        for (int i = 0; i < track.events.size(); i++)
+    // thinning needs the event times, the timeline and the notes are built again without the dropped events
+    if (this->decimate_controllers && !this->lazy_tracks)
+    {
+        int64_t dropped = 0;
+        for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
         {
-            // get event pointer
-            std::unique_ptr<MidiParser::MidiEvent> p_event = std::move(track.events[i]);
+            dropped += decimate_track(trk_idx);
+        }
 
-            double delta = 0.0;
+        UtilityFunctions::print("[GodotMidi] Removed " + String::num_int64(dropped) + " redundant controller and pitch bend events");
+        if (dropped > 0)
+        {
+            build_timeline();
+            build_note_index();
+            publish_snapshot();
+        }
+    }
 
-            // meta events
-            if (p_event->get_type() == MidiParser::MidiEvent::EventType::Meta)
-            {
-                MidiParser::MidiEventMeta meta_event = *dynamic_cast<MidiParser::MidiEventMeta *>(p_event.get());
-                delta = (double)meta_event.delta;
-
-                // load meta event into current track
-                Dictionary event_dict;
-                event_dict["type"] = "meta";
-                event_dict["track"] = trk_idx;
-                // cast to int
-                event_dict["subtype"] = static_cast<int64_t>(meta_event.event_type);
-                event_dict["delta"] = delta;
-                // since raw data is almost never useful for meta events, we store it as a variant
-                // and put it in the data field
-                event_dict["data"] = static_cast<Variant>(meta_event.meta_data);
-                event_dict["channel"] = meta_event.channel;
-
-                // add event to track
-                Array event_array = this->tracks[trk_idx].get("events");
-                event_array.push_back(event_dict);
-
-                // if we have a track name event, update the track name
-                if (meta_event.event_type == MidiParser::MidiEventMeta::MidiMetaEventType::SequenceOrTrackName)
-                {
-                    this->tracks[trk_idx].set("name", meta_event.meta_data);
-                }
-            }
+    // the event dictionaries are built when they're first asked for
+    this->tracks.clear();
+    this->tracks_built = false;
+    report_progress(1.0);
 
-            // note events
-            if (p_event->get_type() == MidiParser::MidiEvent::EventType::Note)
-            {
-                MidiParser::MidiEventNote note_event = *dynamic_cast<MidiParser::MidiEventNote *>(p_event.get());
-                delta = (double)note_event.delta;
-
-                // load note event into current track
-                Dictionary event_dict;
-                event_dict["type"] = "note";
-                event_dict["track"] = trk_idx;
-                event_dict["subtype"] = note_event.event_type;
-                event_dict["delta"] = delta;
-                event_dict["note"] = note_event.note;
-                event_dict["data"] = note_event.data;
-                event_dict["channel"] = note_event.channel;
-
-                // add event to track
-                Array event_array = this->tracks[trk_idx].get("events");
-                event_array.push_back(event_dict);
-            }
+    return OK;
+}
+
+/// @brief Drops the redundant controller and pitch bend events of a track, see ControllerDecimator
+/// the track must already be indexed and have its times, both are updated
+/// @param p_track
+/// @return number of dropped events
+int64_t MidiResource::decimate_track(int p_track)
+{
+    TrackColumns &columns = this->track_columns[p_track];
+    const int64_t num_events = columns.statuses.size();
+    std::vector<uint8_t> keep(num_events);
+    ControllerDecimator::TrackEvents events = {
+        columns.statuses.ptr(),
+        columns.data1.ptr(),
+        columns.data2.ptr(),
+        columns.times.ptr(),
+        static_cast<size_t>(num_events)};
+    const int64_t dropped = static_cast<int64_t>(ControllerDecimator::decimate(events, this->decimation, keep.data()));
+    columns.decimated_events = dropped;
+    if (dropped == 0)
+        return 0;
+
+    int32_t *deltas = columns.deltas.ptrw();
+    uint8_t *statuses = columns.statuses.ptrw();
+    uint8_t *data1 = columns.data1.ptrw();
+    uint8_t *data2 = columns.data2.ptrw();
+    int32_t *payload_offsets = columns.payload_offsets.ptrw();
+    int32_t *payload_lengths = columns.payload_lengths.ptrw();
+
+    // compact in place, the time of a dropped event moves to the next kept one
+    int64_t num_kept = 0;
+    int32_t dropped_delta = 0;
+    for (int64_t i = 0; i < num_events; i++)
+    {
+        if (!keep[i])
+        {
+            dropped_delta += deltas[i];
+            continue;
+        }
+
+        deltas[num_kept] = deltas[i] + dropped_delta;
+        statuses[num_kept] = statuses[i];
+        data1[num_kept] = data1[i];
+        data2[num_kept] = data2[i];
+        payload_offsets[num_kept] = payload_offsets[i];
+        payload_lengths[num_kept] = payload_lengths[i];
+        dropped_delta = 0;
+        num_kept++;
+    }
+
+    columns.deltas.resize(num_kept);
+    columns.statuses.resize(num_kept);
+    columns.data1.resize(num_kept);
+    columns.data2.resize(num_kept);
+    columns.payload_offsets.resize(num_kept);
+    columns.payload_lengths.resize(num_kept);
+
+    index_track(p_track);
+    columns.times.resize(columns.ticks.size());
+    this->tempo_map.ticks_to_seconds(columns.ticks.ptr(), columns.ticks.size(), columns.times.ptrw());
+    return dropped;
+}
+
+/// @brief Gets the number of controller and pitch bend events dropped by the decimate_controllers
+/// option of load_file, lazy tracks count once they've been decoded
+/// @return
+int64_t MidiResource::get_decimated_event_count() const
+{
+    int64_t count = 0;
+    for (const TrackColumns &columns : this->track_columns)
+    {
+        count += columns.decimated_events;
+    }
+    return count;
+}
+
+/// @brief Fills the derived columns of a track (ticks, channels, meta indices and meta events)
+/// @param p_track
+void MidiResource::index_track(int p_track)
+{
+    TrackColumns &columns = this->track_columns[p_track];
+    const int64_t num_events = columns.statuses.size();
+    columns.ticks.resize(num_events);
+    columns.channels.resize(num_events);
+    columns.meta_indices.resize(num_events);
+
+    const int32_t *deltas = columns.deltas.ptr();
+    const uint8_t *statuses = columns.statuses.ptr();
+    int32_t *ticks = columns.ticks.ptrw();
+    uint8_t *channels = columns.channels.ptrw();
+    int32_t *meta_indices = columns.meta_indices.ptrw();
+
+    int64_t tick = 0;
+    int32_t meta_index = 0;
+    for (int64_t i = 0; i < num_events; i++)
+    {
+        tick += deltas[i];
+        ticks[i] = static_cast<int32_t>(tick);
+
+        const MidiDecoder::EventKind kind = MidiDecoder::get_status_info(statuses[i]).kind;
+        channels[i] = kind == MidiDecoder::EventKind::Channel ? (statuses[i] & 0x0F) : 0;
+        meta_indices[i] = kind == MidiDecoder::EventKind::Meta ? meta_index++ : -1;
+    }
+
+    // converted tracks already have their meta events, there are no payloads to build them from
+    if (this->has_meta_payloads)
+    {
+        build_meta_events(p_track);
+    }
+}
+
+/// @brief Builds the dictionaries of the meta events of a track from the meta payloads, in meta_indices order
+/// @param p_track
+void MidiResource::build_meta_events(int p_track)
+{
+    TrackColumns &columns = this->track_columns[p_track];
+    // a new array rather than clear(), published snapshots may still hold the old one
+    columns.meta_events = Array();
+
+    const ByteSpan payloads = Utility::as_span(this->meta_payloads);
+    const int32_t *meta_indices = columns.meta_indices.ptr();
+    for (int64_t i = 0; i < columns.meta_indices.size(); i++)
+    {
+        if (meta_indices[i] < 0)
+            continue;
 
-            // system events
-            if (p_event->get_type() == MidiParser::MidiEvent::EventType::System)
+        MidiDecoder::Event event = {
+            static_cast<uint32_t>(columns.deltas[i]),
+            columns.statuses[i],
+            0,
+            columns.data2[i],
+            columns.data1[i],
+            MidiDecoder::EventKind::Meta,
+            0,
+            columns.payload_offsets[i],
+            static_cast<uint32_t>(columns.payload_lengths[i])};
+        columns.meta_events.push_back(MidiParser::make_event_dictionary(event, payloads, p_track));
+    }
+}
+
+/// @brief Merges the SetTempo events of every track into the tempo map,
+/// fills the times column of every track from it and rebuilds the timeline and the notes
+void MidiResource::build_tempo_map()
+{
+    std::vector<TempoMap::Change> changes;
+    for (const TrackColumns &columns : this->track_columns)
+    {
+        // lazy tracks were scanned for their tempo changes when they were loaded
+        if (columns.lazy)
+        {
+            changes.insert(changes.end(), columns.tempo_changes.begin(), columns.tempo_changes.end());
+            continue;
+        }
+
+        const int32_t *ticks = columns.ticks.ptr();
+        const uint8_t *data1 = columns.data1.ptr();
+        const int32_t *meta_indices = columns.meta_indices.ptr();
+        for (int64_t i = 0; i < columns.meta_indices.size(); i++)
+        {
+            if (meta_indices[i] < 0 || data1[i] != MidiParser::MidiEventMeta::MidiMetaEventType::SetTempo)
+                continue;
+
+            // the value was decoded with the meta event, it's missing if the payload was too short
+            Dictionary event = columns.meta_events[meta_indices[i]];
+            Variant event_tempo = event.get("data", Variant());
+            if (event_tempo.get_type() == Variant::INT)
             {
-                MidiParser::MidiEventSystem system_event = *dynamic_cast<MidiParser::MidiEventSystem *>(p_event.get());
-                delta = (double)system_event.delta;
-
-                // load system event into current track
-                Dictionary event_dict;
-                event_dict["type"] = "system";
-                event_dict["track"] = trk_idx;
-                event_dict["subtype"] = system_event.event_type;
-                event_dict["delta"] = delta;
-                event_dict["channel"] = system_event.channel;
-
-                // add event to track
-                Array event_array = this->tracks[trk_idx].get("events");
-                event_array.push_back(event_dict);
+                changes.push_back({ticks[i], static_cast<int32_t>(static_cast<int64_t>(event_tempo))});
             }
         }
     }
 
-    return OK;
+    this->tempo_map.build(this->division, this->tempo, changes);
+
+    for (TrackColumns &columns : this->track_columns)
+    {
+        columns.times.resize(columns.ticks.size());
+        this->tempo_map.ticks_to_seconds(columns.ticks.ptr(), columns.ticks.size(), columns.times.ptrw());
+    }
+
+    // the timeline and the notes hold a copy of the times
+    build_timeline();
+    build_note_index();
+    publish_snapshot();
 }
 
-Error MidiResource::save_file(const String &p_path, const Ref<Resource> &p_resource)
+/// @brief Replaces the snapshot players read with the current columns and timeline
+/// the packed arrays are shared until one side writes to them, so this only copies references
+void MidiResource::publish_snapshot()
 {
-    return OK;
+    std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+    next->tracks = this->track_columns;
+    next->timeline = this->timeline;
+    next->use_timeline = this->use_timeline;
+    this->snapshot = next;
+}
+
+/// @brief Merges the events of every track into the timeline, or clears it if use_timeline is off
+void MidiResource::build_timeline()
+{
+    this->timeline = Timeline();
+    this->timeline_stale = false;
+    if (!this->use_timeline)
+        return;
+
+    std::vector<MidiTimeline::TrackTicks> track_ticks;
+    int64_t num_events = 0;
+    for (const TrackColumns &columns : this->track_columns)
+    {
+        track_ticks.push_back({columns.ticks.ptr(), static_cast<size_t>(columns.ticks.size())});
+        num_events += columns.ticks.size();
+    }
+
+    this->timeline.tracks.resize(num_events);
+    this->timeline.events.resize(num_events);
+    this->timeline.times.resize(num_events);
+    MidiTimeline::merge(track_ticks, this->timeline.tracks.ptrw(), this->timeline.events.ptrw());
+    this->timeline.finish_position = static_cast<int64_t>(MidiTimeline::finish_position(track_ticks, this->timeline.tracks.ptr(), this->timeline.events.ptr(), num_events));
+
+    // copy the times too so the player reads a single array
+    const int32_t *tracks = this->timeline.tracks.ptr();
+    const int32_t *events = this->timeline.events.ptr();
+    double *times = this->timeline.times.ptrw();
+    for (int64_t i = 0; i < num_events; i++)
+    {
+        times[i] = this->track_columns[tracks[i]].times[events[i]];
+    }
+}
+
+/// @brief Pairs the notes of every track and builds the note index and columns
+void MidiResource::build_note_index()
+{
+    this->notes_stale = false;
+    std::vector<NoteIndex::Note> notes;
+    for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
+    {
+        const TrackColumns &columns = this->track_columns[trk_idx];
+        NoteIndex::TrackEvents events = {
+            columns.statuses.ptr(),
+            columns.data1.ptr(),
+            columns.data2.ptr(),
+            columns.times.ptr(),
+            static_cast<size_t>(columns.statuses.size())};
+        NoteIndex::pair_track(events, trk_idx, notes);
+    }
+    this->note_index.build(std::move(notes));
+
+    const std::vector<NoteIndex::Note> &sorted_notes = this->note_index.get_notes();
+    const int64_t num_notes = static_cast<int64_t>(sorted_notes.size());
+    this->note_columns.starts.resize(num_notes);
+    this->note_columns.durations.resize(num_notes);
+    this->note_columns.pitches.resize(num_notes);
+    this->note_columns.velocities.resize(num_notes);
+    this->note_columns.channels.resize(num_notes);
+    this->note_columns.tracks.resize(num_notes);
+
+    double *starts = this->note_columns.starts.ptrw();
+    double *durations = this->note_columns.durations.ptrw();
+    uint8_t *pitches = this->note_columns.pitches.ptrw();
+    uint8_t *velocities = this->note_columns.velocities.ptrw();
+    uint8_t *channels = this->note_columns.channels.ptrw();
+    int32_t *tracks = this->note_columns.tracks.ptrw();
+    for (int64_t i = 0; i < num_notes; i++)
+    {
+        const NoteIndex::Note &note = sorted_notes[i];
+        starts[i] = note.start;
+        durations[i] = note.end - note.start;
+        pitches[i] = note.pitch;
+        velocities[i] = note.velocity;
+        channels[i] = note.channel;
+        tracks[i] = note.track;
+    }
+}
+
+/// @brief Decodes the columns of a lazy track from its source bytes, the timeline and the notes aren't rebuilt
+/// @param p_track
+void MidiResource::decode_columns(int p_track)
+{
+    TrackColumns &columns = this->track_columns[p_track];
+    if (columns.decoded)
+        return;
+
+    MidiTrack track;
+    track.filter = columns.filter;
+    track.decode(Utility::as_span(columns.source));
+
+    // the payloads were already copied by scan_track in the same order, only the offsets are needed
+    PackedByteArray meta_payloads_scratch;
+    PackedByteArray sysex_data_scratch;
+    fill_columns(track, columns, meta_payloads_scratch, sysex_data_scratch);
+
+    const uint8_t *statuses = columns.statuses.ptr();
+    int32_t *payload_offsets = columns.payload_offsets.ptrw();
+    for (int64_t i = 0; i < columns.statuses.size(); i++)
+    {
+        const MidiDecoder::EventKind kind = MidiDecoder::get_status_info(statuses[i]).kind;
+        if (kind == MidiDecoder::EventKind::Meta)
+            payload_offsets[i] += static_cast<int32_t>(columns.meta_payload_base);
+        else if (kind == MidiDecoder::EventKind::SysEx)
+            payload_offsets[i] += static_cast<int32_t>(columns.sysex_payload_base);
+    }
+
+    columns.decoded = true;
+    index_track(p_track);
+    columns.times.resize(columns.ticks.size());
+    this->tempo_map.ticks_to_seconds(columns.ticks.ptr(), columns.ticks.size(), columns.times.ptrw());
+    if (this->decimate_controllers)
+    {
+        decimate_track(p_track);
+    }
+}
+
+/// @brief Decodes a track loaded with lazy_tracks, does nothing if it's already decoded
+/// the timeline, the notes and the snapshot include it the next time they're read
+/// @param p_track
+void MidiResource::decode_track(int p_track)
+{
+    if (!check_track(p_track) || this->track_columns[p_track].decoded)
+        return;
+
+    decode_columns(p_track);
+    this->timeline_stale = true;
+    this->notes_stale = true;
+}
+
+/// @brief Decodes every track loaded with lazy_tracks that isn't decoded yet
+void MidiResource::decode_all_tracks()
+{
+    for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
+    {
+        decode_track(trk_idx);
+    }
+}
+
+/// @brief Rebuilds the timeline and publishes a new snapshot if tracks were decoded or evicted since the last one
+void MidiResource::refresh_timeline()
+{
+    if (!this->timeline_stale)
+        return;
+
+    build_timeline();
+    publish_snapshot();
+}
+
+/// @brief Decodes every lazy track and rebuilds the notes if they're out of date
+/// a note can start and end in any track, so the notes are only paired over all of them
+void MidiResource::prepare_notes()
+{
+    decode_all_tracks();
+    if (this->notes_stale)
+    {
+        build_note_index();
+    }
+}
+
+/// @brief Gets the events as last published, for players
+/// the snapshot stays valid and unchanged for as long as it's held, even if the resource changes,
+/// tracks loaded with lazy_tracks are only part of it once they're decoded
+/// @return
+std::shared_ptr<const MidiResource::Snapshot> MidiResource::get_snapshot()
+{
+    refresh_timeline();
+    return this->snapshot;
+}
+
+/// @brief Frees the columns of a decoded lazy track, it's decoded again the next time it's used
+/// players that are already playing keep their snapshot, so the memory is only released once they stop
+/// @param p_track
+void MidiResource::evict_track(int p_track)
+{
+    if (!check_track(p_track))
+        return;
+
+    evict_columns(p_track);
+    // the snapshot would hold on to the columns otherwise
+    refresh_timeline();
+}
+
+/// @brief Frees the columns of every decoded lazy track
+void MidiResource::evict_all_tracks()
+{
+    for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
+    {
+        if (this->track_columns[trk_idx].lazy)
+            evict_columns(trk_idx);
+    }
+    refresh_timeline();
+}
+
+/// @brief Frees the columns of a decoded lazy track, the timeline and the notes are only marked out of date
+/// @param p_track
+void MidiResource::evict_columns(int p_track)
+{
+    TrackColumns &columns = this->track_columns[p_track];
+    if (!columns.lazy)
+    {
+        UtilityFunctions::printerr("[GodotMidi] Only tracks loaded with lazy_tracks can be evicted: " + String::num_int64(p_track));
+        return;
+    }
+    if (!columns.decoded)
+        return;
+
+    // the name, the source bytes and the tempo changes stay
+    columns.deltas = PackedInt32Array();
+    columns.statuses = PackedByteArray();
+    columns.data1 = PackedByteArray();
+    columns.data2 = PackedByteArray();
+    columns.payload_offsets = PackedInt32Array();
+    columns.payload_lengths = PackedInt32Array();
+    columns.ticks = PackedInt32Array();
+    columns.times = PackedFloat64Array();
+    columns.channels = PackedByteArray();
+    columns.meta_indices = PackedInt32Array();
+    columns.meta_events = Array();
+    columns.decoded = false;
+
+    // the event dictionaries hold the track too
+    this->tracks.clear();
+    this->tracks_built = false;
+
+    this->timeline_stale = true;
+    this->notes_stale = true;
+}
+
+/// @brief Checks if the columns of a track are decoded, always true unless the track was loaded with lazy_tracks
+/// @param p_track
+/// @return
+bool MidiResource::is_track_decoded(int p_track) const
+{
+    return check_track(p_track) && this->track_columns[p_track].decoded;
+}
+
+/// @brief Builds the event dictionaries of every track from the packed columns
+void MidiResource::build_tracks()
+{
+    decode_all_tracks();
+    this->tracks.clear();
+
+    for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
+    {
+        const TrackColumns &columns = this->track_columns[trk_idx];
+
+        Dictionary track_dict;
+        track_dict["name"] = columns.name;
+        Array event_array;
+        track_dict["events"] = event_array;
+
+        this->tracks.push_back(track_dict);
+
+        for (int64_t i = 0; i < columns.statuses.size(); i++)
+        {
+            Dictionary event_dict = get_event(trk_idx, i);
+            if (event_dict.is_empty())
+                continue;
+
+            // add event to track
+            event_array.push_back(event_dict);
+        }
+    }
+
+    this->tracks_built = true;
+}
+
+/// @brief Sets the tracks of the midi file
+/// the events are converted back into columns, but without the meta payloads
+/// the resource can't be saved in the binary format afterwards
+/// @param p_tracks
+void MidiResource::set_tracks(Array p_tracks)
+{
+    this->tracks = p_tracks;
+    this->tracks_built = true;
+    this->meta_payloads.clear();
+    this->has_meta_payloads = false;
+
+    this->track_columns.clear();
+    this->track_columns.resize(p_tracks.size());
+    for (int trk_idx = 0; trk_idx < static_cast<int>(p_tracks.size()); ++trk_idx)
+    {
+        Dictionary track_dict = p_tracks[trk_idx];
+        TrackColumns &columns = this->track_columns[trk_idx];
+        columns.name = track_dict.get("name", String("Track ") + String::num_int64(trk_idx));
+
+        Array events = track_dict.get("events", Array());
+        for (int64_t i = 0; i < events.size(); i++)
+        {
+            Dictionary event = events[i];
+            String event_type = event.get("type", "undef");
+            int subtype = event.get("subtype", 0);
+            double delta = event.get("delta", 0);
+
+            uint8_t status = 0;
+            uint8_t data1 = 0;
+            uint8_t data2 = 0;
+            int32_t payload_offset = 0;
+            int32_t payload_length = 0;
+            if (event_type == "note")
+            {
+                int channel = event.get("channel", 0);
+                status = static_cast<uint8_t>(((subtype & 0x0F) << 4) | (channel & 0x0F));
+                data1 = static_cast<uint8_t>(static_cast<int>(event.get("note", 0)));
+                data2 = static_cast<uint8_t>(static_cast<int>(event.get("data", 0)));
+            }
+            else if (event_type == "meta")
+            {
+                status = 0xFF;
+                data1 = static_cast<uint8_t>(subtype);
+                columns.meta_events.push_back(event);
+            }
+            else if (event_type == "system")
+            {
+                status = static_cast<uint8_t>(subtype);
+            }
+            else if (event_type == "sysex")
+            {
+                status = static_cast<uint8_t>(subtype);
+                payload_offset = event.get("offset", 0);
+                payload_length = event.get("length", 0);
+            }
+            else
+            {
+                continue;
+            }
+
+            columns.deltas.push_back(static_cast<int32_t>(delta));
+            columns.statuses.push_back(status);
+            columns.data1.push_back(data1);
+            columns.data2.push_back(data2);
+            columns.payload_offsets.push_back(payload_offset);
+            columns.payload_lengths.push_back(payload_length);
+        }
+
+        index_track(trk_idx);
+    }
+
+    build_tempo_map();
+}
+
+/// @brief Gets the tracks of the midi file
+/// @return
+Array MidiResource::get_tracks()
+{
+    if (!this->tracks_built)
+    {
+        build_tracks();
+    }
+    return this->tracks;
+}
+
+/// @brief Checks a track index passed to one of the column accessors
+/// @param p_track
+/// @return
+bool MidiResource::check_track(int p_track) const
+{
+    if (p_track < 0 || p_track >= static_cast<int>(this->track_columns.size()))
+    {
+        UtilityFunctions::printerr("[GodotMidi] Track index out of range: " + String::num_int64(p_track));
+        return false;
+    }
+    return true;
+}
+
+/// @brief Checks a track index passed to one of the column accessors and decodes the track if it's lazy
+/// @param p_track
+/// @return
+bool MidiResource::prepare_track(int p_track)
+{
+    if (!check_track(p_track))
+        return false;
+
+    decode_track(p_track);
+    return true;
+}
+
+/// @brief Gets the number of events in a track, the size of every column of the track
+/// @param p_track
+/// @return
+int64_t MidiResource::get_track_event_count(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].statuses.size() : 0;
+}
+
+/// @brief Gets the absolute time of every event of a track in ticks
+/// @param p_track
+/// @return
+PackedInt32Array MidiResource::get_track_ticks(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].ticks : PackedInt32Array();
+}
+
+/// @brief Gets the time since the previous event of every event of a track in ticks
+/// @param p_track
+/// @return
+PackedInt32Array MidiResource::get_track_deltas(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].deltas : PackedInt32Array();
+}
+
+/// @brief Gets the status byte of every event of a track, 0xFF for meta events
+/// @param p_track
+/// @return
+PackedByteArray MidiResource::get_track_statuses(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].statuses : PackedByteArray();
+}
+
+/// @brief Gets the channel of every event of a track, 0 for events that aren't channel messages
+/// @param p_track
+/// @return
+PackedByteArray MidiResource::get_track_channels(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].channels : PackedByteArray();
+}
+
+/// @brief Gets the first data byte of every event of a track (note, controller, program...),
+/// the meta type for meta events
+/// @param p_track
+/// @return
+PackedByteArray MidiResource::get_track_data1(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].data1 : PackedByteArray();
+}
+
+/// @brief Gets the second data byte of every event of a track (velocity, value...)
+/// @param p_track
+/// @return
+PackedByteArray MidiResource::get_track_data2(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].data2 : PackedByteArray();
+}
+
+/// @brief Gets the index into get_track_meta_events of every event of a track, -1 for events that aren't meta events
+/// @param p_track
+/// @return
+PackedInt32Array MidiResource::get_track_meta_indices(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].meta_indices : PackedInt32Array();
+}
+
+/// @brief Gets the meta events of a track in the same format as the tracks array
+/// @param p_track
+/// @return
+Array MidiResource::get_track_meta_events(int p_track)
+{
+    // a copy, the array is shared with the snapshots players read
+    return prepare_track(p_track) ? this->track_columns[p_track].meta_events.duplicate(true) : Array();
+}
+
+/// @brief Gets the absolute time of every event of a track in seconds, tempo changes included
+/// @param p_track
+/// @return
+PackedFloat64Array MidiResource::get_track_times(int p_track)
+{
+    return prepare_track(p_track) ? this->track_columns[p_track].times : PackedFloat64Array();
+}
+
+/// @brief Gets a single event of a track in the same format as the tracks array
+/// @param p_track
+/// @param p_index
+/// @return an empty dictionary if the index is out of range
+Dictionary MidiResource::get_event(int p_track, int64_t p_index)
+{
+    if (!prepare_track(p_track))
+        return Dictionary();
+
+    const TrackColumns &columns = this->track_columns[p_track];
+    if (p_index < 0 || p_index >= columns.statuses.size())
+    {
+        UtilityFunctions::printerr("[GodotMidi] Event index out of range: " + String::num_int64(p_index));
+        return Dictionary();
+    }
+
+    return make_event(columns, p_track, p_index);
+}
+
+/// @brief Builds the dictionary of a single event from the columns of its track, without any checks
+/// @param p_columns the columns of the track, from the resource or one of its snapshots
+/// @param p_track
+/// @param p_index
+/// @return
+Dictionary MidiResource::make_event(const TrackColumns &p_columns, int p_track, int64_t p_index)
+{
+    // meta events were already converted when the track was loaded, the caller gets
+    // a copy since the columns may be shared with the snapshots players read
+    int32_t meta_index = p_columns.meta_indices[p_index];
+    if (meta_index >= 0)
+        return Dictionary(p_columns.meta_events[meta_index]).duplicate(true);
+
+    const uint8_t status = p_columns.statuses[p_index];
+    MidiDecoder::Event event = {
+        static_cast<uint32_t>(p_columns.deltas[p_index]),
+        status,
+        p_columns.data1[p_index],
+        p_columns.data2[p_index],
+        0,
+        MidiDecoder::get_status_info(status).kind,
+        0,
+        p_columns.payload_offsets[p_index],
+        static_cast<uint32_t>(p_columns.payload_lengths[p_index])};
+    return MidiParser::make_event_dictionary(event, ByteSpan(), p_track);
+}
+
+/// @brief Gets the payload of a sysex event
+/// @param p_event a sysex event from one of the tracks
+/// @return a copy of the payload, empty if the event isn't a sysex event
+PackedByteArray MidiResource::get_sysex_payload(const Dictionary &p_event) const
+{
+    String event_type = p_event.get("type", "undef");
+    if (event_type != "sysex")
+        return PackedByteArray();
+
+    int64_t offset = p_event.get("offset", 0);
+    int64_t length = p_event.get("length", 0);
+    return this->sysex_data.slice(offset, offset + length);
+}
+
+/// @brief Writes a midi resource in the binary format, see write_binary
+/// @param p_path
+/// @param p_resource the MidiResource to save
+/// @return
+Error MidiResource::save_file(const String &p_path, const Ref<Resource> &p_resource)
+{
+    Ref<MidiResource> midi = p_resource;
+    if (midi.is_null())
+    {
+        UtilityFunctions::print("[GodotMidi] Error: Can only save a MidiResource: " + p_path);
+        return ERR_INVALID_PARAMETER;
+    }
+
+    return midi->write_binary(p_path);
+}
+
+/// @brief Writes this resource in the binary format, the inverse of load_binary
+/// layout (little endian):
+///   "GMRS", version, format, division, tempo, track count
+///   string table: track names as u32 length + utf8 bytes
+///   meta payloads and sysex payloads as u32 length + bytes
+///   per track: u32 event count, u64 decimated event count, then the deltas, statuses, data1, data2,
+///   payload offset, payload length, ticks, times, channels and meta index columns back to back
+///   tempo map: u32 segment count, per segment i64 start tick, f64 start seconds, f64 microseconds per tick, i32 tempo
+///   timeline: u32 entry count (0 when use_timeline is off), the tracks, events and times columns, u64 finish position
+///   notes: u32 note count, the starts, ends, pitches, velocities, channels and tracks columns in start order
+/// @param p_path
+/// @return
+Error MidiResource::write_binary(const String &p_path)
+{
+    if (!has_binary_data())
+    {
+        UtilityFunctions::print("[GodotMidi] Error: MidiResource has no packed events to save, its tracks were set directly: " + p_path);
+        return ERR_UNAVAILABLE;
+    }
+
+    // lazy tracks are written like any other track, with the timeline and the notes they're part of
+    prepare_notes();
+    refresh_timeline();
+
+    godot::Ref<godot::FileAccess> file = FileAccess::open(p_path, FileAccess::WRITE);
+    if (file.is_null())
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Could not open file for writing: ") + p_path);
+        return ERR_FILE_CANT_WRITE;
+    }
+
+    file->store_buffer(PackedByteArray({'G', 'M', 'R', 'S'}));
+    file->store_32(BINARY_VERSION);
+    file->store_32(static_cast<uint32_t>(this->format));
+    file->store_32(static_cast<uint32_t>(this->division));
+    file->store_32(static_cast<uint32_t>(this->tempo));
+    file->store_32(static_cast<uint32_t>(this->track_columns.size()));
+
+    // string table
+    for (const TrackColumns &columns : this->track_columns)
+    {
+        PackedByteArray name = columns.name.to_utf8_buffer();
+        file->store_32(static_cast<uint32_t>(name.size()));
+        file->store_buffer(name);
+    }
+
+    file->store_32(static_cast<uint32_t>(this->meta_payloads.size()));
+    file->store_buffer(this->meta_payloads);
+    file->store_32(static_cast<uint32_t>(this->sysex_data.size()));
+    file->store_buffer(this->sysex_data);
+
+    for (const TrackColumns &columns : this->track_columns)
+    {
+        file->store_32(static_cast<uint32_t>(columns.statuses.size()));
+        file->store_64(static_cast<uint64_t>(columns.decimated_events));
+        file->store_buffer(columns.deltas.to_byte_array());
+        file->store_buffer(columns.statuses);
+        file->store_buffer(columns.data1);
+        file->store_buffer(columns.data2);
+        file->store_buffer(columns.payload_offsets.to_byte_array());
+        file->store_buffer(columns.payload_lengths.to_byte_array());
+        file->store_buffer(columns.ticks.to_byte_array());
+        file->store_buffer(columns.times.to_byte_array());
+        file->store_buffer(columns.channels);
+        file->store_buffer(columns.meta_indices.to_byte_array());
+    }
+
+    // the derived data is written as well, so loading doesn't have to rebuild it
+    const std::vector<TempoMap::Segment> &segments = this->tempo_map.get_segments();
+    file->store_32(static_cast<uint32_t>(segments.size()));
+    for (const TempoMap::Segment &segment : segments)
+    {
+        file->store_64(static_cast<uint64_t>(segment.start_tick));
+        file->store_double(segment.start_seconds);
+        file->store_double(segment.microseconds_per_tick);
+        file->store_32(static_cast<uint32_t>(segment.tempo));
+    }
+
+    file->store_32(static_cast<uint32_t>(this->timeline.tracks.size()));
+    file->store_buffer(this->timeline.tracks.to_byte_array());
+    file->store_buffer(this->timeline.events.to_byte_array());
+    file->store_buffer(this->timeline.times.to_byte_array());
+    file->store_64(static_cast<uint64_t>(this->timeline.finish_position));
+
+    // the note columns hold durations, the ends are written so the index gets back the exact values
+    const std::vector<NoteIndex::Note> &notes = this->note_index.get_notes();
+    PackedFloat64Array note_ends;
+    note_ends.resize(static_cast<int64_t>(notes.size()));
+    double *ends = note_ends.ptrw();
+    for (size_t i = 0; i < notes.size(); i++)
+    {
+        ends[i] = notes[i].end;
+    }
+    file->store_32(static_cast<uint32_t>(notes.size()));
+    file->store_buffer(this->note_columns.starts.to_byte_array());
+    file->store_buffer(note_ends.to_byte_array());
+    file->store_buffer(this->note_columns.pitches);
+    file->store_buffer(this->note_columns.velocities);
+    file->store_buffer(this->note_columns.channels);
+    file->store_buffer(this->note_columns.tracks.to_byte_array());
+
+    if (file->get_error() != OK)
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Could not write file: ") + p_path);
+        return ERR_FILE_CANT_WRITE;
+    }
+
+    return OK;
+}
+
+/// @brief Loads a resource written by save_file, the columns, the tempo map, the timeline and the notes
+/// are read straight into packed arrays, only the meta event dictionaries are built again
+/// @param p_path path to the .midires file
+/// @return
+Error MidiResource::load_binary(const String &p_path)
+{
+    if (!check_idle())
+        return ERR_BUSY;
+
+    godot::Ref<godot::FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
+    if (file.is_null())
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Could not open file: ") + p_path);
+        return ERR_FILE_CANT_OPEN;
+    }
+
+    PackedByteArray magic = file->get_buffer(4);
+    if (magic.size() != 4 || magic[0] != 'G' || magic[1] != 'M' || magic[2] != 'R' || magic[3] != 'S')
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Not a midi resource file: ") + p_path);
+        return ERR_FILE_UNRECOGNIZED;
+    }
+
+    uint32_t version = file->get_32();
+    if (version != BINARY_VERSION)
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Unsupported midi resource version ") + String::num_int64(version) + ", reimport the midi file: " + p_path);
+        return ERR_FILE_UNRECOGNIZED;
+    }
+
+    // every count is checked against the bytes that are left, so a damaged file can't ask for huge buffers
+    const auto read_block = [&](uint64_t size, PackedByteArray &block) -> bool
+    {
+        if (size > file->get_length() - file->get_position())
+            return false;
+
+        block = file->get_buffer(static_cast<int64_t>(size));
+        return static_cast<uint64_t>(block.size()) == size;
+    };
+
+    const auto corrupt = [&]()
+    {
+        UtilityFunctions::print(String("[GodotMidi] Error: Midi resource file is corrupt: ") + p_path);
+        return ERR_FILE_CORRUPT;
+    };
+
+    int file_format = static_cast<int32_t>(file->get_32());
+    int file_division = static_cast<int32_t>(file->get_32());
+    int file_tempo = static_cast<int32_t>(file->get_32());
+    uint32_t num_tracks = file->get_32();
+
+    // a track takes at least its name length and event count
+    if (static_cast<uint64_t>(num_tracks) * 2 * sizeof(uint32_t) > file->get_length() - file->get_position())
+        return corrupt();
+
+    std::vector<TrackColumns> columns_in(num_tracks);
+
+    for (TrackColumns &columns : columns_in)
+    {
+        PackedByteArray name;
+        if (!read_block(file->get_32(), name))
+            return corrupt();
+        columns.name = name.get_string_from_utf8();
+    }
+
+    PackedByteArray meta_payloads_in;
+    PackedByteArray sysex_data_in;
+    if (!read_block(file->get_32(), meta_payloads_in) || !read_block(file->get_32(), sysex_data_in))
+        return corrupt();
+
+    int64_t total_events = 0;
+    for (TrackColumns &columns : columns_in)
+    {
+        uint64_t num_events = file->get_32();
+        columns.decimated_events = static_cast<int64_t>(file->get_64());
+        PackedByteArray deltas;
+        PackedByteArray payload_offsets;
+        PackedByteArray payload_lengths;
+        PackedByteArray ticks;
+        PackedByteArray times;
+        PackedByteArray meta_indices;
+        if (!read_block(num_events * sizeof(int32_t), deltas) ||
+            !read_block(num_events, columns.statuses) ||
+            !read_block(num_events, columns.data1) ||
+            !read_block(num_events, columns.data2) ||
+            !read_block(num_events * sizeof(int32_t), payload_offsets) ||
+            !read_block(num_events * sizeof(int32_t), payload_lengths) ||
+            !read_block(num_events * sizeof(int32_t), ticks) ||
+            !read_block(num_events * sizeof(double), times) ||
+            !read_block(num_events, columns.channels) ||
+            !read_block(num_events * sizeof(int32_t), meta_indices))
+            return corrupt();
+
+        columns.deltas = deltas.to_int32_array();
+        columns.payload_offsets = payload_offsets.to_int32_array();
+        columns.payload_lengths = payload_lengths.to_int32_array();
+        columns.ticks = ticks.to_int32_array();
+        columns.times = times.to_float64_array();
+        columns.meta_indices = meta_indices.to_int32_array();
+
+        // the meta events are built by walking this, so it has to count up from 0
+        int32_t meta_index = 0;
+        for (int64_t i = 0; i < columns.meta_indices.size(); i++)
+        {
+            const int32_t index = columns.meta_indices[i];
+            if (index >= 0 && index != meta_index++)
+                return corrupt();
+        }
+        total_events += static_cast<int64_t>(num_events);
+    }
+
+    // 28 bytes per segment
+    const uint32_t num_segments = file->get_32();
+    if (static_cast<uint64_t>(num_segments) * 28 > file->get_length() - file->get_position())
+        return corrupt();
+
+    std::vector<TempoMap::Segment> segments(num_segments);
+    for (TempoMap::Segment &segment : segments)
+    {
+        segment.start_tick = static_cast<int64_t>(file->get_64());
+        segment.start_seconds = file->get_double();
+        segment.microseconds_per_tick = file->get_double();
+        segment.tempo = static_cast<int32_t>(file->get_32());
+    }
+    TempoMap tempo_map_in;
+    if (!tempo_map_in.assign(std::move(segments)))
+        return corrupt();
+
+    Timeline timeline_in;
+    const uint64_t num_entries = file->get_32();
+    PackedByteArray timeline_tracks;
+    PackedByteArray timeline_events;
+    PackedByteArray timeline_times;
+    if (!read_block(num_entries * sizeof(int32_t), timeline_tracks) ||
+        !read_block(num_entries * sizeof(int32_t), timeline_events) ||
+        !read_block(num_entries * sizeof(double), timeline_times))
+        return corrupt();
+
+    timeline_in.tracks = timeline_tracks.to_int32_array();
+    timeline_in.events = timeline_events.to_int32_array();
+    timeline_in.times = timeline_times.to_float64_array();
+    timeline_in.finish_position = static_cast<int64_t>(file->get_64());
+    // players index the tracks with these without checking
+    if (num_entries != 0 && static_cast<int64_t>(num_entries) != total_events)
+        return corrupt();
+    if (timeline_in.finish_position < 0 || timeline_in.finish_position > static_cast<int64_t>(num_entries))
+        return corrupt();
+    for (int64_t i = 0; i < timeline_in.tracks.size(); i++)
+    {
+        const int32_t track = timeline_in.tracks[i];
+        if (track < 0 || track >= static_cast<int32_t>(num_tracks) ||
+            timeline_in.events[i] < 0 || timeline_in.events[i] >= columns_in[track].statuses.size())
+            return corrupt();
+    }
+
+    NoteColumns note_columns_in;
+    const uint64_t num_notes = file->get_32();
+    PackedByteArray note_starts;
+    PackedByteArray note_ends;
+    PackedByteArray note_tracks;
+    if (!read_block(num_notes * sizeof(double), note_starts) ||
+        !read_block(num_notes * sizeof(double), note_ends) ||
+        !read_block(num_notes, note_columns_in.pitches) ||
+        !read_block(num_notes, note_columns_in.velocities) ||
+        !read_block(num_notes, note_columns_in.channels) ||
+        !read_block(num_notes * sizeof(int32_t), note_tracks))
+        return corrupt();
+
+    note_columns_in.starts = note_starts.to_float64_array();
+    note_columns_in.tracks = note_tracks.to_int32_array();
+    const PackedFloat64Array ends = note_ends.to_float64_array();
+    note_columns_in.durations.resize(static_cast<int64_t>(num_notes));
+
+    std::vector<NoteIndex::Note> notes(num_notes);
+    const double *starts = note_columns_in.starts.ptr();
+    double *durations = note_columns_in.durations.ptrw();
+    for (size_t i = 0; i < notes.size(); i++)
+    {
+        notes[i] = {starts[i], ends[i], note_columns_in.pitches[i], note_columns_in.velocities[i], note_columns_in.channels[i], note_columns_in.tracks[i]};
+        durations[i] = ends[i] - starts[i];
+    }
+    NoteIndex note_index_in;
+    if (!note_index_in.assign(std::move(notes)))
+        return corrupt();
+
+    // only touch the resource once the whole file was read
+    this->format = file_format;
+    this->division = file_division;
+    this->tempo = file_tempo;
+    this->track_count = static_cast<int>(num_tracks);
+    this->track_columns = std::move(columns_in);
+    this->meta_payloads = meta_payloads_in;
+    this->sysex_data = sysex_data_in;
+    this->diagnostics = Dictionary();
+
+    this->has_meta_payloads = true;
+    this->tempo_map = std::move(tempo_map_in);
+    this->note_index = std::move(note_index_in);
+    this->note_columns = note_columns_in;
+    this->notes_stale = false;
+
+    // the meta events are the only part that isn't stored, there are only a few per track
+    for (int trk_idx = 0; trk_idx < static_cast<int>(this->track_columns.size()); ++trk_idx)
+    {
+        build_meta_events(trk_idx);
+    }
+
+    // a file saved without the timeline only has it built when it's wanted here
+    if (this->use_timeline && timeline_in.tracks.size() != total_events)
+    {
+        build_timeline();
+    }
+    else
+    {
+        this->timeline = this->use_timeline ? timeline_in : Timeline();
+        this->timeline_stale = false;
+    }
+    publish_snapshot();
+
+    this->tracks.clear();
+    this->tracks_built = false;
+
+    return OK;
+}
+
+/// @brief Sets the division of the midi file in ticks per quarter note, event times are recomputed
+/// @param p_division
+void MidiResource::set_division(int p_division)
+{
+    this->division = p_division;
+    build_tempo_map();
+}
+
+/// @brief Sets the tempo at the start of the song in microseconds per quarter note, event times are recomputed
+/// @param p_tempo
+void MidiResource::set_tempo(int p_tempo)
+{
+    this->tempo = p_tempo;
+    build_tempo_map();
+}
+
+/// @brief Converts a position in ticks into seconds since the start of the song, tempo changes included
+/// @param p_tick
+/// @return
+double MidiResource::tick_to_seconds(double p_tick) const
+{
+    return this->tempo_map.tick_to_seconds(p_tick);
+}
+
+/// @brief Converts seconds since the start of the song into a position in ticks, tempo changes included
+/// @param p_seconds
+/// @return
+double MidiResource::seconds_to_tick(double p_seconds) const
+{
+    return this->tempo_map.seconds_to_tick(p_seconds);
+}
+
+/// @brief Gets the tempo map, one entry per stretch of constant tempo
+/// @return [{ "tick": int, "time": float, "tempo": int }, ...], the first entry starts at tick 0
+Array MidiResource::get_tempo_changes() const
+{
+    Array result;
+    for (const TempoMap::Segment &segment : this->tempo_map.get_segments())
+    {
+        Dictionary tempo_dict;
+        tempo_dict["tick"] = segment.start_tick;
+        tempo_dict["time"] = segment.start_seconds;
+        tempo_dict["tempo"] = segment.tempo;
+        result.push_back(tempo_dict);
+    }
+    return result;
+}
+
+/// @brief Sets whether the tracks are also merged into a single timeline sorted by time,
+/// MidiPlayer then walks one stream instead of checking every track
+/// @param p_use_timeline
+void MidiResource::set_use_timeline(bool p_use_timeline)
+{
+    this->use_timeline = p_use_timeline;
+    build_timeline();
+    publish_snapshot();
+}
+
+/// @brief Gets the track of every entry of the timeline, tracks loaded with lazy_tracks are left out until they're decoded
+/// @return
+PackedInt32Array MidiResource::get_timeline_tracks()
+{
+    refresh_timeline();
+    return this->timeline.tracks;
+}
+
+/// @brief Gets the index inside of its track of every entry of the timeline, see get_event
+/// @return
+PackedInt32Array MidiResource::get_timeline_events()
+{
+    refresh_timeline();
+    return this->timeline.events;
+}
+
+/// @brief Gets the absolute time in seconds of every entry of the timeline
+/// @return
+PackedFloat64Array MidiResource::get_timeline_times()
+{
+    refresh_timeline();
+    return this->timeline.times;
+}
+
+/// @brief Gets the paired notes, sorted by start time
+/// the note queries decode every track loaded with lazy_tracks first, see prepare_notes
+/// @return
+const NoteIndex &MidiResource::get_note_index()
+{
+    prepare_notes();
+    return this->note_index;
+}
+
+/// @brief Gets the number of paired notes
+/// @return
+int64_t MidiResource::get_note_count()
+{
+    return static_cast<int64_t>(get_note_index().get_notes().size());
+}
+
+/// @brief Gets the start of every note in seconds
+/// @return
+PackedFloat64Array MidiResource::get_note_starts()
+{
+    prepare_notes();
+    return this->note_columns.starts;
+}
+
+/// @brief Gets the duration of every note in seconds
+/// @return
+PackedFloat64Array MidiResource::get_note_durations()
+{
+    prepare_notes();
+    return this->note_columns.durations;
+}
+
+/// @brief Gets the pitch of every note
+/// @return
+PackedByteArray MidiResource::get_note_pitches()
+{
+    prepare_notes();
+    return this->note_columns.pitches;
+}
+
+/// @brief Gets the note on velocity of every note
+/// @return
+PackedByteArray MidiResource::get_note_velocities()
+{
+    prepare_notes();
+    return this->note_columns.velocities;
+}
+
+/// @brief Gets the channel of every note
+/// @return
+PackedByteArray MidiResource::get_note_channels()
+{
+    prepare_notes();
+    return this->note_columns.channels;
+}
+
+/// @brief Gets the track of every note
+/// @return
+PackedInt32Array MidiResource::get_note_tracks()
+{
+    prepare_notes();
+    return this->note_columns.tracks;
+}
+
+/// @brief Gets a single paired note
+/// @param p_index index into the note columns
+/// @return { "start", "duration", "pitch", "velocity", "channel", "track" }, empty if the index is out of range
+Dictionary MidiResource::get_note(int64_t p_index)
+{
+    if (p_index < 0 || p_index >= get_note_count())
+    {
+        UtilityFunctions::printerr("[GodotMidi] Note index out of range: " + String::num_int64(p_index));
+        return Dictionary();
+    }
+
+    const NoteIndex::Note &note = this->note_index.get_notes()[p_index];
+    Dictionary note_dict;
+    note_dict["start"] = note.start;
+    note_dict["duration"] = note.end - note.start;
+    note_dict["pitch"] = note.pitch;
+    note_dict["velocity"] = note.velocity;
+    note_dict["channel"] = note.channel;
+    note_dict["track"] = note.track;
+    return note_dict;
+}
+
+/// @brief Finds the notes that overlap a time window, for piano rolls and chart lookups
+/// @param p_t0 start of the window in seconds
+/// @param p_t1 end of the window in seconds
+/// @param p_pitch_lo lowest pitch to include
+/// @param p_pitch_hi highest pitch to include
+/// @return indices into the note columns, in order of start time
+PackedInt32Array MidiResource::get_notes_in_range(double p_t0, double p_t1, int p_pitch_lo, int p_pitch_hi)
+{
+    std::vector<int32_t> found;
+    get_note_index().query_range(p_t0, p_t1, static_cast<uint8_t>(CLAMP(p_pitch_lo, 0, 127)), static_cast<uint8_t>(CLAMP(p_pitch_hi, 0, 127)), found);
+
+    PackedInt32Array result;
+    result.resize(static_cast<int64_t>(found.size()));
+    if (!found.empty())
+        memcpy(result.ptrw(), found.data(), found.size() * sizeof(int32_t));
+    return result;
+}
+
+/// @brief Finds the notes that are held at a point in time
+/// @param p_time seconds since the start of the song
+/// @return indices into the note columns, in order of start time
+PackedInt32Array MidiResource::get_sounding_notes(double p_time)
+{
+    std::vector<int32_t> found;
+    get_note_index().query_sounding(p_time, found);
+
+    PackedInt32Array result;
+    result.resize(static_cast<int64_t>(found.size()));
+    if (!found.empty())
+        memcpy(result.ptrw(), found.data(), found.size() * sizeof(int32_t));
+    return result;
 }
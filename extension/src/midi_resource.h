@@ -12,8 +12,22 @@
 #include <godot_cpp/classes/ref.hpp>
 #include <godot_cpp/variant/dictionary.hpp>
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/hashing_context.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
 
 #include "midi_resource.h"
+#include "core/byte_span.h"
+#include "core/tempo_map.h"
+#include "core/midi_timeline.h"
+#include "core/note_index.h"
+#include "core/event_filter.h"
+#include "core/controller_decimator.h"
 
 using namespace godot;
 
@@ -45,21 +59,350 @@ protected:
         ClassDB::bind_method(D_METHOD("get_tracks"), &MidiResource::get_tracks);
         ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "tracks"), "set_tracks", "get_tracks");
 
+        ClassDB::bind_method(D_METHOD("get_track_event_count", "track"), &MidiResource::get_track_event_count);
+        ClassDB::bind_method(D_METHOD("get_track_ticks", "track"), &MidiResource::get_track_ticks);
+        ClassDB::bind_method(D_METHOD("get_track_deltas", "track"), &MidiResource::get_track_deltas);
+        ClassDB::bind_method(D_METHOD("get_track_statuses", "track"), &MidiResource::get_track_statuses);
+        ClassDB::bind_method(D_METHOD("get_track_channels", "track"), &MidiResource::get_track_channels);
+        ClassDB::bind_method(D_METHOD("get_track_data1", "track"), &MidiResource::get_track_data1);
+        ClassDB::bind_method(D_METHOD("get_track_data2", "track"), &MidiResource::get_track_data2);
+        ClassDB::bind_method(D_METHOD("get_track_meta_indices", "track"), &MidiResource::get_track_meta_indices);
+        ClassDB::bind_method(D_METHOD("get_track_meta_events", "track"), &MidiResource::get_track_meta_events);
+        ClassDB::bind_method(D_METHOD("get_track_times", "track"), &MidiResource::get_track_times);
+        ClassDB::bind_method(D_METHOD("get_event", "track", "index"), &MidiResource::get_event);
+
+        ClassDB::bind_method(D_METHOD("set_lazy_tracks", "lazy_tracks"), &MidiResource::set_lazy_tracks);
+        ClassDB::bind_method(D_METHOD("get_lazy_tracks"), &MidiResource::get_lazy_tracks);
+        ClassDB::bind_method(D_METHOD("decode_track", "track"), &MidiResource::decode_track);
+        ClassDB::bind_method(D_METHOD("decode_all_tracks"), &MidiResource::decode_all_tracks);
+        ClassDB::bind_method(D_METHOD("evict_track", "track"), &MidiResource::evict_track);
+        ClassDB::bind_method(D_METHOD("evict_all_tracks"), &MidiResource::evict_all_tracks);
+        ClassDB::bind_method(D_METHOD("is_track_decoded", "track"), &MidiResource::is_track_decoded);
+
+        ClassDB::bind_method(D_METHOD("set_use_timeline", "use_timeline"), &MidiResource::set_use_timeline);
+        ClassDB::bind_method(D_METHOD("get_use_timeline"), &MidiResource::get_use_timeline);
+        ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_timeline"), "set_use_timeline", "get_use_timeline");
+        ClassDB::bind_method(D_METHOD("get_timeline_tracks"), &MidiResource::get_timeline_tracks);
+        ClassDB::bind_method(D_METHOD("get_timeline_events"), &MidiResource::get_timeline_events);
+        ClassDB::bind_method(D_METHOD("get_timeline_times"), &MidiResource::get_timeline_times);
+
+        ClassDB::bind_method(D_METHOD("get_note_count"), &MidiResource::get_note_count);
+        ClassDB::bind_method(D_METHOD("get_note_starts"), &MidiResource::get_note_starts);
+        ClassDB::bind_method(D_METHOD("get_note_durations"), &MidiResource::get_note_durations);
+        ClassDB::bind_method(D_METHOD("get_note_pitches"), &MidiResource::get_note_pitches);
+        ClassDB::bind_method(D_METHOD("get_note_velocities"), &MidiResource::get_note_velocities);
+        ClassDB::bind_method(D_METHOD("get_note_channels"), &MidiResource::get_note_channels);
+        ClassDB::bind_method(D_METHOD("get_note_tracks"), &MidiResource::get_note_tracks);
+        ClassDB::bind_method(D_METHOD("get_note", "index"), &MidiResource::get_note);
+        ClassDB::bind_method(D_METHOD("get_notes_in_range", "t0", "t1", "pitch_lo", "pitch_hi"), &MidiResource::get_notes_in_range, DEFVAL(0), DEFVAL(127));
+        ClassDB::bind_method(D_METHOD("get_sounding_notes", "time"), &MidiResource::get_sounding_notes);
+
+        ClassDB::bind_method(D_METHOD("tick_to_seconds", "tick"), &MidiResource::tick_to_seconds);
+        ClassDB::bind_method(D_METHOD("seconds_to_tick", "seconds"), &MidiResource::seconds_to_tick);
+        ClassDB::bind_method(D_METHOD("get_tempo_changes"), &MidiResource::get_tempo_changes);
+
+        ClassDB::bind_method(D_METHOD("set_sysex_data", "sysex_data"), &MidiResource::set_sysex_data);
+        ClassDB::bind_method(D_METHOD("get_sysex_data"), &MidiResource::get_sysex_data);
+        ADD_PROPERTY(PropertyInfo(Variant::PACKED_BYTE_ARRAY, "sysex_data"), "set_sysex_data", "get_sysex_data");
+        ClassDB::bind_method(D_METHOD("get_sysex_payload", "event"), &MidiResource::get_sysex_payload);
+
         // save and load methods
-        ClassDB::bind_method(D_METHOD("load_file", "path"), &MidiResource::load_file);
+        ClassDB::bind_method(D_METHOD("load_file", "path", "options"), &MidiResource::load_file, DEFVAL(Dictionary()));
+        ClassDB::bind_method(D_METHOD("load_file_cached", "path", "options", "cache_dir"), &MidiResource::load_file_cached);
+        ClassDB::bind_method(D_METHOD("load_file_async", "path", "options"), &MidiResource::load_file_async, DEFVAL(Dictionary()));
+        ClassDB::bind_method(D_METHOD("is_loading"), &MidiResource::is_loading);
         ClassDB::bind_method(D_METHOD("save_file", "path", "resource"), &MidiResource::save_file);
+        ClassDB::bind_method(D_METHOD("load_binary", "path"), &MidiResource::load_binary);
+
+        ClassDB::bind_method(D_METHOD("set_use_memory_map", "use_memory_map"), &MidiResource::set_use_memory_map);
+        ClassDB::bind_method(D_METHOD("get_use_memory_map"), &MidiResource::get_use_memory_map);
+        ClassDB::bind_method(D_METHOD("get_last_load_mode"), &MidiResource::get_last_load_mode);
+        ClassDB::bind_method(D_METHOD("get_parse_allocation_count"), &MidiResource::get_parse_allocation_count);
+        ClassDB::bind_method(D_METHOD("get_decimated_event_count"), &MidiResource::get_decimated_event_count);
+        ClassDB::bind_method(D_METHOD("get_diagnostics"), &MidiResource::get_diagnostics);
+
+        ADD_SIGNAL(MethodInfo("load_progress", PropertyInfo(Variant::FLOAT, "fraction")));
+        ADD_SIGNAL(MethodInfo("load_completed", PropertyInfo(Variant::INT, "error")));
+
+        BIND_ENUM_CONSTANT(LOAD_MODE_BUFFERED);
+        BIND_ENUM_CONSTANT(LOAD_MODE_MEMORY_MAPPED);
     }
 
+public:
+    /// @brief How the source file was read by the last call to load_file
+    enum LoadMode
+    {
+        LOAD_MODE_BUFFERED = 0,
+        LOAD_MODE_MEMORY_MAPPED = 1
+    };
+
+    /// @brief Extension of the binary format written by save_file
+    static constexpr const char *BINARY_EXTENSION = "midires";
+    /// @brief Bumped whenever the layout of the binary format changes
+    static constexpr uint32_t BINARY_VERSION = 3;
+    /// @brief Bumped whenever the parser, the filters or the decimation give a different result for the same
+    /// file and options, so load_file_cached doesn't keep serving what older code produced
+    static constexpr uint32_t IMPORT_CACHE_VERSION = 1;
+
+    /// @brief The events of one track, one packed array per field
+    /// this is what the binary format stores, the event dictionaries are built from it
+    struct TrackColumns
+    {
+        String name;
+        PackedInt32Array deltas;
+        // status byte, 0xFF for meta events
+        PackedByteArray statuses;
+        // note/controller/program, the type for meta events
+        PackedByteArray data1;
+        PackedByteArray data2;
+        // meta payloads point into meta_payloads, sysex payloads into sysex_data
+        PackedInt32Array payload_offsets;
+        PackedInt32Array payload_lengths;
+
+        // derived from the columns above when the track is parsed, load_binary reads all but meta_events back
+
+        // absolute time of each event in ticks
+        PackedInt32Array ticks;
+        // absolute time of each event in seconds, from the tempo map
+        PackedFloat64Array times;
+        // channel of channel messages, 0 for everything else
+        PackedByteArray channels;
+        // index into meta_events for meta events, -1 for everything else
+        PackedInt32Array meta_indices;
+        // dictionaries of the meta events, there are only a few per track
+        Array meta_events;
+        // controller and pitch bend events dropped by decimate_controllers, saved so cached loads report it too
+        int64_t decimated_events = 0;
+
+        // only used by tracks loaded with lazy_tracks
+
+        // whether the columns were read from the source bytes, the columns above are empty until then
+        bool decoded = true;
+        bool lazy = false;
+        // the contents of the MTrk chunk up to the first damaged event
+        PackedByteArray source;
+        // read when the track was loaded, so the tempo map covers tracks that aren't decoded
+        std::vector<TempoMap::Change> tempo_changes;
+        // where the payloads of the track start in meta_payloads and sysex_data
+        int64_t meta_payload_base = 0;
+        int64_t sysex_payload_base = 0;
+        // the load_file options that apply to the track
+        EventFilter filter;
+    };
+
+    /// @brief Every event of every track in one stream sorted by time
+    struct Timeline
+    {
+        // track of every entry
+        PackedInt32Array tracks;
+        // index of every entry inside of its track
+        PackedInt32Array events;
+        // absolute time of every entry in seconds
+        PackedFloat64Array times;
+        // playback is finished once this many entries fired, see MidiTimeline::finish_position
+        int64_t finish_position = 0;
+    };
+
+    /// @brief Everything a MidiPlayer reads while playing, shared by every player of the resource
+    /// a new snapshot is published whenever the events change, a published one is never modified
+    struct Snapshot
+    {
+        std::vector<TrackColumns> tracks;
+        // empty when use_timeline is off
+        Timeline timeline;
+        bool use_timeline = true;
+    };
+
+    /// @brief Paired notes sorted by start time, one packed array per field
+    struct NoteColumns
+    {
+        // seconds since the start of the song
+        PackedFloat64Array starts;
+        PackedFloat64Array durations;
+        PackedByteArray pitches;
+        PackedByteArray velocities;
+        PackedByteArray channels;
+        PackedInt32Array tracks;
+    };
+
 private:
-    int format;
-    int track_count;
-    int division;
-    int tempo;
-    Array tracks;
+    int format = 0;
+    int track_count = 0;
+    int division = 48;
+    int tempo = 500000;
+    // built from track_columns the first time it's needed
+    mutable Array tracks;
+    mutable bool tracks_built = false;
+    // payloads of every sysex event, back to back, events hold an offset and length into it
+    PackedByteArray sysex_data;
+
+    std::vector<TrackColumns> track_columns;
+    // payloads of every meta event, back to back
+    PackedByteArray meta_payloads;
+    // false when the columns were converted from a tracks array (set_tracks), the meta payloads
+    // are missing then so the resource can't be saved in the binary format
+    bool has_meta_payloads = true;
+    // the tempo changes of every track merged
+    TempoMap tempo_map;
+    // whether to keep the merged timeline, it costs 16 bytes per event
+    bool use_timeline = true;
+    Timeline timeline;
+    // note on/off pairs of every track for range queries
+    NoteIndex note_index;
+    NoteColumns note_columns;
+    // what players read, replaced as a whole by publish_snapshot
+    std::shared_ptr<const Snapshot> snapshot = std::make_shared<const Snapshot>();
+    // set when lazy tracks are decoded or evicted, the timeline and the snapshot are only
+    // rebuilt the next time they're read so decoding several tracks merges them once
+    bool timeline_stale = false;
+    // same for the note index and the note columns
+    bool notes_stale = false;
+
+    bool use_memory_map = false;
+    bool lazy_tracks = false;
+    // controller thinning, set by load_file
+    bool decimate_controllers = false;
+    ControllerDecimator::Settings decimation;
+    LoadMode last_load_mode = LOAD_MODE_BUFFERED;
+    int64_t parse_allocation_count = 0;
+    Dictionary diagnostics;
+
+    // load_file_async state, the load is parsed into a separate resource and adopted when it's done
+    std::atomic<bool> loading{false};
+    int64_t load_task_id = -1;
+    // the resource being loaded into, written by the worker before it hands over to the main thread
+    Ref<MidiResource> pending_load;
+    // keeps this resource alive until the worker is done with it
+    Ref<MidiResource> load_owner;
+    // set on the resource the worker parses into, progress is emitted by this one
+    MidiResource *progress_target = nullptr;
+
+    Error parse_bytes(const ByteSpan &p_bytes, const Dictionary &p_options);
+    Error write_binary(const String &p_path);
+    void index_track(int p_track);
+    void build_meta_events(int p_track);
+    void build_tempo_map();
+    void build_timeline();
+    void build_note_index();
+    void publish_snapshot();
+    void refresh_timeline();
+    void prepare_notes();
+    void build_tracks();
+    bool check_track(int p_track) const;
+    bool prepare_track(int p_track);
+    void decode_columns(int p_track);
+    void evict_columns(int p_track);
+    int64_t decimate_track(int p_track);
+    void report_progress(double p_fraction);
+    void adopt(MidiResource &p_other);
+    void load_async_internal(const String &p_path, const Dictionary &p_options);
+    void finish_load_internal(Error p_error);
+    bool check_idle() const;
 
 public:
-    Error load_file(const String &p_path);
+    Error load_file(const String &p_path, const Dictionary &p_options);
+    Error load_file_cached(const String &p_path, const Dictionary &p_options, const String &p_cache_dir);
     Error save_file(const String &p_path, const Ref<Resource> &p_resource);
+    Error load_binary(const String &p_path);
+
+    Error load_file_async(const String &p_path, const Dictionary &p_options);
+
+    /// @brief Gets whether a load_file_async is still running, the other loads are rejected until it's done
+    /// @return
+    inline bool is_loading() const { return loading.load(); }
+
+    /// @brief Checks if the resource can be written in the binary format by save_file
+    /// @return
+    inline bool has_binary_data() const { return has_meta_payloads; }
+
+    std::shared_ptr<const Snapshot> get_snapshot();
+
+    static Dictionary make_event(const TrackColumns &p_columns, int p_track, int64_t p_index);
+
+    // per track event columns, the same index is the same event in every column
+
+    int64_t get_track_event_count(int p_track);
+    PackedInt32Array get_track_ticks(int p_track);
+    PackedInt32Array get_track_deltas(int p_track);
+    PackedByteArray get_track_statuses(int p_track);
+    PackedByteArray get_track_channels(int p_track);
+    PackedByteArray get_track_data1(int p_track);
+    PackedByteArray get_track_data2(int p_track);
+    PackedInt32Array get_track_meta_indices(int p_track);
+    Array get_track_meta_events(int p_track);
+    PackedFloat64Array get_track_times(int p_track);
+    Dictionary get_event(int p_track, int64_t p_index);
+
+    void decode_track(int p_track);
+    void decode_all_tracks();
+    void evict_track(int p_track);
+    void evict_all_tracks();
+    bool is_track_decoded(int p_track) const;
+
+    /// @brief Gets the merged tempo changes of every track
+    /// @return
+    inline const TempoMap &get_tempo_map() const { return tempo_map; }
+
+    void set_use_timeline(bool p_use_timeline);
+
+    /// @brief Gets whether the tracks are also merged into a single timeline
+    /// @return
+    inline bool get_use_timeline() const { return use_timeline; }
+
+    PackedInt32Array get_timeline_tracks();
+    PackedInt32Array get_timeline_events();
+    PackedFloat64Array get_timeline_times();
+
+    const NoteIndex &get_note_index();
+    int64_t get_note_count();
+    PackedFloat64Array get_note_starts();
+    PackedFloat64Array get_note_durations();
+    PackedByteArray get_note_pitches();
+    PackedByteArray get_note_velocities();
+    PackedByteArray get_note_channels();
+    PackedInt32Array get_note_tracks();
+    Dictionary get_note(int64_t p_index);
+    PackedInt32Array get_notes_in_range(double p_t0, double p_t1, int p_pitch_lo, int p_pitch_hi);
+    PackedInt32Array get_sounding_notes(double p_time);
+
+    double tick_to_seconds(double p_tick) const;
+    double seconds_to_tick(double p_seconds) const;
+    Array get_tempo_changes() const;
+
+    /// @brief Sets whether load_file should memory map the source file instead of reading it into a buffer
+    /// falls back to buffered reads when mapping isn't possible (other platforms, exported pack files)
+    /// @param p_use_memory_map
+    inline void set_use_memory_map(bool p_use_memory_map) { use_memory_map = p_use_memory_map; }
+
+    /// @brief Gets whether load_file should memory map the source file
+    /// @return
+    inline bool get_use_memory_map() const { return use_memory_map; }
+
+    /// @brief Sets whether load_file should keep the tracks as raw bytes and only decode a track when it's first used
+    /// loading only reads the track names, payloads and tempo changes, see decode_track and evict_track
+    /// @param p_lazy_tracks
+    inline void set_lazy_tracks(bool p_lazy_tracks) { lazy_tracks = p_lazy_tracks; }
+
+    /// @brief Gets whether load_file decodes tracks on first use
+    /// @return
+    inline bool get_lazy_tracks() const { return lazy_tracks; }
+
+    /// @brief Gets how the source file was read by the last call to load_file
+    /// @return
+    inline LoadMode get_last_load_mode() const { return last_load_mode; }
+
+    /// @brief Gets the number of heap blocks the parser arenas needed during the last load
+    /// the event columns of a track are sized up front, so this should stay close to the track count
+    /// @return
+    inline int64_t get_parse_allocation_count() const { return parse_allocation_count; }
+
+    int64_t get_decimated_event_count() const;
+
+    /// @brief Gets the problems found by the last call to load_file
+    /// every category maps to { "count", "offsets" }, offsets are byte offsets into the file
+    /// of the first few occurrences, "bytes_skipped" counts the bytes that were ignored
+    /// @return
+    inline Dictionary get_diagnostics() const { return diagnostics; }
 
     // getters and setters
 
@@ -79,29 +422,32 @@ public:
     /// @return
     inline int get_track_count() const { return track_count; }
 
-    /// @brief Sets the division of the midi file in ticks per quarter note
-    /// @param p_division
-    inline void set_division(int p_division) { division = p_division; }
+    void set_division(int p_division);
 
     /// @brief Gets the division of the midi file in ticks per quarter note
     /// @return
     inline int get_division() const { return division; }
 
-    /// @brief Sets the tempo in microseconds per quarter note
-    /// @param p_tempo
-    inline void set_tempo(int p_tempo) { tempo = p_tempo; }
+    void set_tempo(int p_tempo);
 
-    /// @brief Gets the tempo in microseconds per quarter note
+    /// @brief Gets the tempo at the start of the song in microseconds per quarter note
     /// @return
     inline int get_tempo() const { return tempo; }
 
-    /// @brief Sets the tracks of the midi file
-    /// @param p_tracks
-    inline void set_tracks(Array p_tracks) { tracks = p_tracks; }
+    void set_tracks(Array p_tracks);
+    Array get_tracks();
+
+    /// @brief Sets the payloads of the sysex events
+    /// @param p_sysex_data
+    inline void set_sysex_data(const PackedByteArray &p_sysex_data) { sysex_data = p_sysex_data; }
 
-    /// @brief Gets the tracks of the midi file
+    /// @brief Gets the payloads of the sysex events, stored back to back in one buffer
     /// @return
-    inline Array get_tracks() const { return tracks; }
+    inline PackedByteArray get_sysex_data() const { return sysex_data; }
+
+    PackedByteArray get_sysex_payload(const Dictionary &p_event) const;
 };
 
+VARIANT_ENUM_CAST(MidiResource::LoadMode);
+
 #endif // MIDI_RESOURCE_H
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "midi_resource_format.h"
+
+PackedStringArray MidiResourceFormatLoader::_get_recognized_extensions() const
+{
+    PackedStringArray extensions;
+    extensions.push_back(MidiResource::BINARY_EXTENSION);
+    return extensions;
+}
+
+bool MidiResourceFormatLoader::_handles_type(const StringName &p_type) const
+{
+    return p_type == StringName("MidiResource");
+}
+
+String MidiResourceFormatLoader::_get_resource_type(const String &p_path) const
+{
+    if (p_path.get_extension().to_lower() == MidiResource::BINARY_EXTENSION)
+    {
+        return "MidiResource";
+    }
+    return "";
+}
+
+/// @brief Loads a .midires file
+/// @param p_path
+/// @param p_original_path
+/// @param p_use_sub_threads
+/// @param p_cache_mode
+/// @return the MidiResource, or an Error code if the file couldn't be read
+Variant MidiResourceFormatLoader::_load(const String &p_path, const String &p_original_path, bool p_use_sub_threads, int32_t p_cache_mode) const
+{
+    Ref<MidiResource> midi;
+    midi.instantiate();
+
+    Error err = midi->load_binary(p_path);
+    if (err != OK)
+    {
+        return err;
+    }
+
+    return midi;
+}
+
+Error MidiResourceFormatSaver::_save(const Ref<Resource> &p_resource, const String &p_path, uint32_t p_flags)
+{
+    Ref<MidiResource> midi = p_resource;
+    if (midi.is_null())
+    {
+        return ERR_INVALID_PARAMETER;
+    }
+
+    return midi->save_file(p_path, midi);
+}
+
+/// @brief Only MidiResources that still hold their packed events can be written,
+/// the default saver handles the rest
+/// @param p_resource
+/// @return
+bool MidiResourceFormatSaver::_recognize(const Ref<Resource> &p_resource) const
+{
+    Ref<MidiResource> midi = p_resource;
+    return midi.is_valid() && midi->has_binary_data();
+}
+
+PackedStringArray MidiResourceFormatSaver::_get_recognized_extensions(const Ref<Resource> &p_resource) const
+{
+    PackedStringArray extensions;
+    if (this->_recognize(p_resource))
+    {
+        extensions.push_back(MidiResource::BINARY_EXTENSION);
+    }
+    return extensions;
+}
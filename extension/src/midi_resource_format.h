@@ -0,0 +1,45 @@
+#ifndef MIDI_RESOURCE_FORMAT_H
+#define MIDI_RESOURCE_FORMAT_H
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/defs.hpp>
+#include <godot_cpp/godot.hpp>
+
+#include <godot_cpp/classes/resource_format_loader.hpp>
+#include <godot_cpp/classes/resource_format_saver.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+
+#include "midi_resource.h"
+
+using namespace godot;
+
+/// @brief Loads MidiResources saved in the binary .midires format, see MidiResource::load_binary
+class MidiResourceFormatLoader : public ResourceFormatLoader
+{
+    GDCLASS(MidiResourceFormatLoader, ResourceFormatLoader);
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    PackedStringArray _get_recognized_extensions() const override;
+    bool _handles_type(const StringName &p_type) const override;
+    String _get_resource_type(const String &p_path) const override;
+    Variant _load(const String &p_path, const String &p_original_path, bool p_use_sub_threads, int32_t p_cache_mode) const override;
+};
+
+/// @brief Saves MidiResources in the binary .midires format, see MidiResource::save_file
+class MidiResourceFormatSaver : public ResourceFormatSaver
+{
+    GDCLASS(MidiResourceFormatSaver, ResourceFormatSaver);
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    Error _save(const Ref<Resource> &p_resource, const String &p_path, uint32_t p_flags) override;
+    bool _recognize(const Ref<Resource> &p_resource) const override;
+    PackedStringArray _get_recognized_extensions(const Ref<Resource> &p_resource) const override;
+};
+
+#endif // MIDI_RESOURCE_FORMAT_H
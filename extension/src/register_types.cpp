@@ -3,15 +3,21 @@
 #include "midi_parser.h"
 #include "midi_resource.h"
 #include "midi_player.h"
+#include "midi_resource_format.h"
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/godot.hpp>
 #include <godot_cpp/classes/editor_import_plugin.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
+#include <godot_cpp/classes/resource_saver.hpp>
 
 using namespace godot;
 
+static Ref<MidiResourceFormatLoader> midi_resource_loader;
+static Ref<MidiResourceFormatSaver> midi_resource_saver;
+
 void initialize_godotmidi_types(ModuleInitializationLevel p_level)
 {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE)
@@ -21,6 +27,14 @@ void initialize_godotmidi_types(ModuleInitializationLevel p_level)
 	ClassDB::register_class<MidiParser>();
 	ClassDB::register_class<MidiResource>();
 	ClassDB::register_class<MidiPlayer>();
+	ClassDB::register_class<MidiResourceFormatLoader>();
+	ClassDB::register_class<MidiResourceFormatSaver>();
+
+	// binary .midires files written by the importer
+	midi_resource_loader.instantiate();
+	ResourceLoader::get_singleton()->add_resource_format_loader(midi_resource_loader);
+	midi_resource_saver.instantiate();
+	ResourceSaver::get_singleton()->add_resource_format_saver(midi_resource_saver);
 }
 
 void uninitialize_godotmidi_types(ModuleInitializationLevel p_level)
@@ -29,6 +43,11 @@ void uninitialize_godotmidi_types(ModuleInitializationLevel p_level)
 	{
 		return;
 	}
+
+	ResourceLoader::get_singleton()->remove_resource_format_loader(midi_resource_loader);
+	midi_resource_loader.unref();
+	ResourceSaver::get_singleton()->remove_resource_format_saver(midi_resource_saver);
+	midi_resource_saver.unref();
 }
 
 extern "C"
@@ -4,18 +4,18 @@
 /// @param bytes
 /// @param offset
 /// @return
-int32_t Utility::decode_int32_be(PackedByteArray bytes, int32_t offset)
+int32_t Utility::decode_int32_be(const ByteSpan &bytes, int32_t offset)
 {
-    return (bytes[offset] << 24) | (bytes[offset + 1] << 16) | (bytes[offset + 2] << 8) | (bytes[offset + 3]);
+    return static_cast<int32_t>(bytes.read_u32_be(offset));
 }
 
 /// @brief decode bytes to int from 16 bit big endian stream
 /// @param bytes
 /// @param offset
 /// @return
-int16_t Utility::decode_int16_be(PackedByteArray bytes, int32_t offset)
+int16_t Utility::decode_int16_be(const ByteSpan &bytes, int32_t offset)
 {
-    return (bytes[offset] << 8) | (bytes[offset + 1]);
+    return static_cast<int16_t>(bytes.read_u16_be(offset));
 }
 
 /// @brief decode bytes to int from variable big endian stream
@@ -24,7 +24,7 @@ int16_t Utility::decode_int16_be(PackedByteArray bytes, int32_t offset)
 /// @param offset
 /// @param length [out] length of varint
 /// @return
-int64_t Utility::decode_varint_be(PackedByteArray bytes, int32_t offset, int32_t &length)
+int64_t Utility::decode_varint_be(const ByteSpan &bytes, int32_t offset, int32_t &length)
 {
     int32_t value = 0;
     uint8_t byte = 0;
@@ -35,6 +35,10 @@ int64_t Utility::decode_varint_be(PackedByteArray bytes, int32_t offset, int32_t
         value &= 0x7f;
         do
         {
+            // a truncated varint ends at the end of the span
+            if (i + 1 >= bytes.size)
+                break;
+
             value = (value << 7) + ((byte = bytes[++i]) & 0x7f);
             length++;
         } while (byte & 0x80);
@@ -47,16 +51,37 @@ int64_t Utility::decode_varint_be(PackedByteArray bytes, int32_t offset, int32_t
 /// @param bytes
 /// @param offset
 /// @return
-int32_t Utility::decode_int24_be(PackedByteArray bytes, int32_t offset)
+int32_t Utility::decode_int24_be(const ByteSpan &bytes, int32_t offset)
 {
-    return (bytes[offset] << 16) | (bytes[offset + 1] << 8) | bytes[offset + 2];
+    return static_cast<int32_t>(bytes.read_u24_be(offset));
+}
+
+/// @brief decode a run of bytes into a string, one character per byte (latin-1)
+/// the characters are written straight into the string, so embedded NULs are kept
+/// @param bytes
+/// @return
+String Utility::decode_string_ascii(const ByteSpan &bytes)
+{
+    String text;
+    if (bytes.size <= 0)
+        return text;
+
+    // resize counts the terminating NUL
+    text.resize(bytes.size + 1);
+    char32_t *chars = text.ptrw();
+    for (int64_t i = 0; i < bytes.size; i++)
+    {
+        chars[i] = bytes[i];
+    }
+    chars[bytes.size] = 0;
+    return text;
 }
 
-String Utility::print_bits(PackedByteArray bytes)
+String Utility::print_bits(const ByteSpan &bytes)
 {
     // print bits
     String bits = "";
-    for (int i = 0; i < bytes.size(); i++)
+    for (int i = 0; i < bytes.size; i++)
     {
         for (int j = 7; j >= 0; j--)
         {
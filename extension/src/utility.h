@@ -4,6 +4,8 @@
 #include <godot_cpp/variant/packed_byte_array.hpp>
 #include <godot_cpp/variant/string.hpp>
 
+#include "core/byte_span.h"
+
 using namespace godot;
 
 // utility class
@@ -11,11 +13,21 @@ using namespace godot;
 class Utility
 {
 public:
-    static int32_t decode_int32_be(PackedByteArray bytes, int32_t offset);
-    static int16_t decode_int16_be(PackedByteArray bytes, int32_t offset);
-    static int64_t decode_varint_be(PackedByteArray bytes, int32_t offset, int32_t &length);
-    static int32_t decode_int24_be(PackedByteArray bytes, int32_t offset);
-    static String print_bits(PackedByteArray bytes);
+    static int32_t decode_int32_be(const ByteSpan &bytes, int32_t offset);
+    static int16_t decode_int16_be(const ByteSpan &bytes, int32_t offset);
+    static int64_t decode_varint_be(const ByteSpan &bytes, int32_t offset, int32_t &length);
+    static int32_t decode_int24_be(const ByteSpan &bytes, int32_t offset);
+    static String decode_string_ascii(const ByteSpan &bytes);
+    static String print_bits(const ByteSpan &bytes);
+
+    /// @brief Creates a span over the contents of a packed byte array without copying
+    /// the array must not be resized while the span is in use
+    /// @param bytes
+    /// @return
+    static inline ByteSpan as_span(const PackedByteArray &bytes)
+    {
+        return ByteSpan(bytes.ptr(), bytes.size());
+    }
 };
 
 #endif // MIDI_UTILITY_H
\ No newline at end of file
@@ -1,11 +1,14 @@
 @tool
 extends EditorPlugin
 
+const MidiImportPlugin = preload("midi_import_plugin.gd")
+
 var import_plugin
 var export_plugin: AndroidExportPlugin
 
 func _enter_tree():
-	import_plugin = preload("midi_import_plugin.gd").new()
+	_add_project_settings()
+	import_plugin = MidiImportPlugin.new()
 	add_import_plugin(import_plugin)
 	export_plugin = AndroidExportPlugin.new()
 	add_export_plugin(export_plugin)
@@ -18,6 +21,19 @@ func _exit_tree():
 	remove_export_plugin(export_plugin)
 	export_plugin = null
 
+# shows the import cache directory in Project Settings, with its default
+func _add_project_settings():
+	var setting = MidiImportPlugin.CACHE_DIR_SETTING
+	if not ProjectSettings.has_setting(setting):
+		ProjectSettings.set_setting(setting, MidiImportPlugin.DEFAULT_CACHE_DIR)
+	ProjectSettings.set_initial_value(setting, MidiImportPlugin.DEFAULT_CACHE_DIR)
+	ProjectSettings.set_as_basic(setting, true)
+	ProjectSettings.add_property_info({
+		"name": setting,
+		"type": TYPE_STRING,
+		"hint": PROPERTY_HINT_DIR,
+	})
+
 class AndroidExportPlugin extends EditorExportPlugin:
 	var _plugin_name = "GodotMidi"
 
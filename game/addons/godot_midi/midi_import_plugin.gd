@@ -3,6 +3,12 @@ extends EditorImportPlugin
 
 enum Presets { DEFAULT }
 
+# where parsed files are kept between imports, an empty string turns the cache off
+# point it at a directory your CI keeps between runs to skip unchanged files on a fresh import
+# registered in Project Settings by godot_midi.gd
+const CACHE_DIR_SETTING = "godot_midi/import/cache_dir"
+const DEFAULT_CACHE_DIR = "res://.godot/godot_midi_cache"
+
 func _get_importer_name():
 	return "com.nlaha.godotmidi"
 
@@ -13,7 +19,8 @@ func _get_recognized_extensions() -> PackedStringArray:
 	return PackedStringArray(["mid", "midi"])
 
 func _get_save_extension():
-	return "res"
+	# binary format written by MidiResource.save_file, events are stored as packed columns
+	return "midires"
 
 func _get_resource_type():
 	return "MidiResource"
@@ -28,9 +35,25 @@ func _get_option_visibility(option, name, options):
 	return true
 	
 func _get_import_options(name, preset):
+	# passed to MidiResource.load_file, dropped events are never decoded into the resource
+	# tempo changes are always kept so timing stays the same
 	match preset:
 		Presets.DEFAULT:
-			return []
+			return [
+				{ "name": "drop_meta", "default_value": false },
+				{ "name": "drop_system", "default_value": false },
+				{ "name": "drop_controllers", "default_value": false },
+				{ "name": "drop_pitch_bend", "default_value": false },
+				{ "name": "drop_aftertouch", "default_value": false },
+				# empty keeps every channel/track
+				{ "name": "channels", "default_value": PackedInt32Array() },
+				{ "name": "tracks", "default_value": PackedInt32Array() },
+				# thins dense controller and pitch bend curves, 0 tolerances only drop repeated values
+				{ "name": "decimate_controllers", "default_value": false },
+				{ "name": "controller_tolerance", "default_value": 0 },
+				{ "name": "pitch_bend_tolerance", "default_value": 0 },
+				{ "name": "decimate_min_interval", "default_value": 0.0 },
+			]
 		_:
 			return []
 
@@ -44,14 +67,31 @@ func _get_preset_name(preset):
 func _get_import_order():
 	return 0
 
+func _get_format_version():
+	# 1: saved as .midires instead of .res
+	# 2: .midires also holds the tempo map, timeline and notes
+	# 3: .midires also holds the decimated event count
+	return 3
+
 func _import(source_file, save_path, options, r_platform_variants, r_gen_files):
 
 	print("[GodotMidi] Importing midi file: " + source_file)
 
 	var save_file = save_path + "." + _get_save_extension()
 	var midi_resource = MidiResource.new()
-	if midi_resource.load_file(source_file) != OK:
+	# unchanged files with unchanged options are read back from the cache instead of parsed again
+	var cache_dir = ProjectSettings.get_setting(CACHE_DIR_SETTING, DEFAULT_CACHE_DIR)
+	var err = OK
+	if cache_dir.is_empty():
+		err = midi_resource.load_file(source_file, options)
+	else:
+		err = midi_resource.load_file_cached(source_file, options, cache_dir)
+
+	if err != OK:
 		printerr("[GodotMidi] Failed to load midi file: " + source_file)
 		return FAILED
 
+	if midi_resource.get_decimated_event_count() > 0:
+		print("[GodotMidi] Decimated " + str(midi_resource.get_decimated_event_count()) + " events in: " + source_file)
+
 	return ResourceSaver.save(midi_resource, save_file)
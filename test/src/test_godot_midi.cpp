@@ -1,16 +1,1108 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest.h>
 
-#include <godot_cpp/variant/string.hpp>
-#include <midi_parser.h>
+#include <controller_decimator.h>
+#include <midi_decoder.h>
+#include <event_filter.h>
+#include <midi_event_store.h>
+#include <midi_file.h>
+#include <midi_probe.h>
+#include <midi_scheduler.h>
+#include <midi_timeline.h>
+#include <midi_track.h>
+#include <note_index.h>
+#include <tempo_map.h>
+#include <parse_arena.h>
+#include <parse_diagnostics.h>
 
-using namespace godot;
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
 
 TEST_CASE("Test can parse midi header") {
-	PackedByteArray* midi_data = memnew(PackedByteArray({0x4D, 0x54, 0x68, 0x64, 0x00, 0x00, 0x00, 0x06, 0x00, 0x01, 0x00, 0x02, 0x00, 0x30}));
-	
-    // MidiParser::RawMidiChunk header_chunk;
-    // midi_data = header_chunk.load_from_bytes(midi_data);
-	
-	CHECK_EQ(midi_data->size(), 14);
-}
\ No newline at end of file
+    const uint8_t midi_data[] = {0x4D, 0x54, 0x68, 0x64, 0x00, 0x00, 0x00, 0x06, 0x00, 0x01, 0x00, 0x02, 0x00, 0x30};
+
+    MidiFile::Chunk header_chunk;
+    ByteSpan remaining = MidiFile::read_chunk(ByteSpan(midi_data, sizeof(midi_data)), header_chunk);
+    CHECK(remaining.is_empty());
+    CHECK_EQ(header_chunk.type, MidiFile::ChunkType::Header);
+    CHECK_EQ(header_chunk.size, 6);
+
+    MidiFile::FileHeader header;
+    REQUIRE(MidiFile::read_header(header_chunk, header));
+    CHECK_EQ(header.format, 1);
+    CHECK_EQ(header.num_tracks, 2);
+    CHECK_EQ(header.division_type, MidiFile::DivisionType::TicksPerQuarterNote);
+    CHECK_EQ(header.division, 0x30);
+}
+
+TEST_CASE("Chunk lengths past the sane bound are rejected instead of going negative") {
+    // what the incremental parser reads before it waits for or skips a chunk
+    const uint8_t huge_chunk[] = {0x4D, 0x54, 0x72, 0x6B, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x2F, 0x00};
+    int64_t size = -1;
+    CHECK_FALSE(MidiFile::read_chunk_size(ByteSpan(huge_chunk, sizeof(huge_chunk)), size));
+    CHECK_EQ(size, 0);
+
+    // incomplete headers wait for more data
+    CHECK_FALSE(MidiFile::read_chunk_size(ByteSpan(huge_chunk, 7), size));
+
+    const uint8_t track_chunk[] = {0x4D, 0x54, 0x72, 0x6B, 0x00, 0x00, 0x00, 0x04, 0x00, 0xFF, 0x2F, 0x00};
+    REQUIRE(MidiFile::read_chunk_size(ByteSpan(track_chunk, 8), size));
+    CHECK_EQ(size, 4);
+
+    // whole file reads clamp the chunk to the data that's there
+    MidiFile::Chunk chunk;
+    ByteSpan remaining = MidiFile::read_chunk(ByteSpan(huge_chunk, sizeof(huge_chunk)), chunk);
+    CHECK(remaining.is_empty());
+    CHECK_EQ(chunk.data.size, 4);
+}
+
+/// @brief builds a dense note stream, note on/off pairs with optional running status
+static std::vector<uint8_t> make_note_stream(int num_notes, bool running_status)
+{
+    std::vector<uint8_t> track;
+    track.reserve(num_notes * 8 + 4);
+    for (int i = 0; i < num_notes; i++)
+    {
+        uint8_t note = 36 + (i % 48);
+        // note on, delta 0
+        track.push_back(0x00);
+        if (!running_status || i == 0)
+            track.push_back(0x90);
+        track.push_back(note);
+        track.push_back(100);
+        // note off as a zero velocity note on, two byte delta
+        track.push_back(0x81);
+        track.push_back(0x40);
+        if (!running_status)
+            track.push_back(0x90);
+        track.push_back(note);
+        track.push_back(0);
+    }
+    // end of track
+    track.insert(track.end(), {0x00, 0xFF, 0x2F, 0x00});
+    return track;
+}
+
+/// @brief the switch based event loop the parser used before MidiDecoder,
+/// kept here as a baseline for the benchmark below (no running status, no bounds checks)
+template <typename Sink>
+static void legacy_switch_decode(const ByteSpan &track, Sink &&sink)
+{
+    int64_t offset = 0;
+    while (offset < track.size)
+    {
+        MidiDecoder::Event event = {};
+        if (!MidiDecoder::read_vlq(track, offset, event.delta))
+            break;
+
+        int32_t event_type = track[offset];
+        offset += 1;
+        int32_t event_code = event_type >> 4;
+        if (event_type == 0xFF)
+            event_code = 0xFF;
+
+        event.status = event_type;
+        switch (event_code)
+        {
+        case 0x08: // note off
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            event.data2 = track[offset + 1];
+            offset += 2;
+            sink(event);
+            break;
+        }
+        case 0x09: // note on
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            event.data2 = track[offset + 1];
+            offset += 2;
+            sink(event);
+            break;
+        }
+        case 0x0A: // note aftertouch
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            event.data2 = track[offset + 1];
+            offset += 2;
+            sink(event);
+            break;
+        }
+        case 0x0B: // controller
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            event.data2 = track[offset + 1];
+            offset += 2;
+            sink(event);
+            break;
+        }
+        case 0x0C: // program change
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            offset += 1;
+            sink(event);
+            break;
+        }
+        case 0x0D: // channel pressure
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            offset += 1;
+            sink(event);
+            break;
+        }
+        case 0x0E: // pitch bend
+        {
+            event.kind = MidiDecoder::EventKind::Channel;
+            event.data1 = track[offset];
+            event.data2 = track[offset + 1];
+            offset += 2;
+            sink(event);
+            break;
+        }
+        case 0x0F: // system event
+        {
+            event.kind = MidiDecoder::EventKind::System;
+            sink(event);
+            break;
+        }
+        case 0xFF: // meta event
+        {
+            event.kind = MidiDecoder::EventKind::Meta;
+            event.meta_type = track[offset];
+            offset += 1;
+            MidiDecoder::read_vlq(track, offset, event.payload_length);
+            event.payload_offset = offset;
+            offset += event.payload_length;
+            sink(event);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+TEST_CASE("Decoder handles running status") {
+    std::vector<uint8_t> explicit_status = make_note_stream(64, false);
+    std::vector<uint8_t> running_status = make_note_stream(64, true);
+
+    std::vector<MidiDecoder::Event> expected;
+    std::vector<MidiDecoder::Event> actual;
+    MidiDecoder::Result explicit_result = MidiDecoder::decode_track(ByteSpan(explicit_status.data(), explicit_status.size()), [&](const MidiDecoder::Event &event)
+                                                                    { expected.push_back(event); return true; });
+    MidiDecoder::Result running_result = MidiDecoder::decode_track(ByteSpan(running_status.data(), running_status.size()), [&](const MidiDecoder::Event &event)
+                                                                   { actual.push_back(event); return true; });
+
+    CHECK_EQ(explicit_result, MidiDecoder::Result::Ok);
+    CHECK_EQ(running_result, MidiDecoder::Result::Ok);
+    REQUIRE_EQ(expected.size(), actual.size());
+    CHECK_EQ(actual.size(), 64 * 2 + 1);
+    for (size_t i = 0; i < actual.size(); i++)
+    {
+        CHECK_EQ(actual[i].delta, expected[i].delta);
+        CHECK_EQ(actual[i].status, expected[i].status);
+        CHECK_EQ(actual[i].data1, expected[i].data1);
+        CHECK_EQ(actual[i].data2, expected[i].data2);
+    }
+    CHECK_EQ(actual.back().kind, MidiDecoder::EventKind::Meta);
+    CHECK_EQ(actual.back().meta_type, MidiDecoder::META_END_OF_TRACK);
+}
+
+TEST_CASE("Decoder reports truncated events") {
+    // note on with its velocity byte missing
+    std::vector<uint8_t> track = {0x00, 0x90, 0x3C};
+    int num_events = 0;
+    MidiDecoder::Result result = MidiDecoder::decode_track(ByteSpan(track.data(), track.size()), [&](const MidiDecoder::Event &)
+                                                           { num_events++; return true; });
+    CHECK_EQ(result, MidiDecoder::Result::Truncated);
+    CHECK_EQ(num_events, 0);
+}
+
+TEST_CASE("Decoder reads the data bytes get_status_info reports") {
+    static_assert(MidiDecoder::get_status_info(0x90).data_length == 2, "the lengths are known at compile time");
+
+    for (int status = 0x80; status < 0xF0; status++)
+    {
+        const MidiDecoder::StatusInfo info = MidiDecoder::get_status_info(static_cast<uint8_t>(status));
+        CHECK_EQ(info.kind, MidiDecoder::EventKind::Channel);
+
+        const uint8_t bytes[] = {0x00, static_cast<uint8_t>(status), 0x40, 0x41};
+        MidiDecoder::State state;
+        MidiDecoder::Event event;
+        int64_t offset = 0;
+        REQUIRE_EQ(MidiDecoder::decode_event(ByteSpan(bytes, sizeof(bytes)), offset, state, event), MidiDecoder::Result::Ok);
+        CHECK_EQ(offset, 2 + info.data_length);
+        CHECK_EQ(event.data2, info.data_length == 2 ? 0x41 : 0);
+
+        // one byte short of the message
+        offset = 0;
+        state = MidiDecoder::State();
+        CHECK_EQ(MidiDecoder::decode_event(ByteSpan(bytes, 1 + info.data_length), offset, state, event), MidiDecoder::Result::Truncated);
+    }
+    CHECK_EQ(MidiDecoder::get_status_info(0x40).kind, MidiDecoder::EventKind::Unknown);
+    CHECK_EQ(MidiDecoder::get_status_info(0xFF).kind, MidiDecoder::EventKind::Meta);
+}
+
+TEST_CASE("Benchmark decoder against the legacy switch decoder") {
+    const int num_notes = 500000;
+    std::vector<uint8_t> track = make_note_stream(num_notes, false);
+    ByteSpan span(track.data(), track.size());
+
+    // best of a few alternating rounds, a single pass is mostly scheduler noise
+    double legacy_rate = 0.0;
+    double decoder_rate = 0.0;
+    for (int round = 0; round < 10; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int legacy_events = 0;
+        uint32_t legacy_checksum = 0;
+        legacy_switch_decode(span, [&](const MidiDecoder::Event &event)
+                             { legacy_events++; legacy_checksum += event.data1; return true; });
+        auto legacy_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        int decoder_events = 0;
+        uint32_t checksum = 0;
+        MidiDecoder::decode_track(span, [&](const MidiDecoder::Event &event)
+                                  { decoder_events++; checksum += event.data1; return true; });
+        auto decoder_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK_EQ(legacy_events, decoder_events);
+        CHECK_EQ(legacy_checksum, checksum);
+        legacy_rate = std::max(legacy_rate, legacy_events / legacy_time / 1e6);
+        decoder_rate = std::max(decoder_rate, decoder_events / decoder_time / 1e6);
+    }
+    MESSAGE("switch decoder: " << legacy_rate << " M events/s, decoder: " << decoder_rate << " M events/s");
+}
+
+/// @brief appends a variable length quantity
+static void append_vlq(std::vector<uint8_t> &stream, uint32_t value)
+{
+    uint8_t buffer[4];
+    int length = 0;
+    buffer[length++] = value & 0x7F;
+    while (value >>= 7)
+    {
+        buffer[length++] = 0x80 | (value & 0x7F);
+    }
+    while (length > 0)
+    {
+        stream.push_back(buffer[--length]);
+    }
+}
+
+/// @brief builds notes with 3 and 4 byte delta times and every 16th event a text
+/// meta event with a 2 byte payload length, the deltas the decoder doesn't read inline
+static std::vector<uint8_t> make_long_vlq_stream(int num_events, std::vector<uint32_t> &deltas, std::vector<uint32_t> &payload_lengths)
+{
+    std::vector<uint8_t> stream;
+    deltas.clear();
+    payload_lengths.clear();
+    uint32_t seed = 12345;
+    for (int i = 0; i < num_events; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        // 16384 and up takes 3 bytes, 2097152 and up takes 4
+        uint32_t delta = 16384 + (seed >> 4) % 4000000;
+        deltas.push_back(delta);
+        append_vlq(stream, delta);
+
+        if (i % 16 == 0)
+        {
+            uint32_t length = 128 + (seed >> 20) % 400;
+            payload_lengths.push_back(length);
+            stream.insert(stream.end(), {0xFF, 0x01});
+            append_vlq(stream, length);
+            stream.insert(stream.end(), length, 'x');
+        }
+        else
+        {
+            stream.insert(stream.end(), {0x90, uint8_t(36 + i % 48), 100});
+        }
+    }
+    // end of track
+    stream.insert(stream.end(), {0x00, 0xFF, 0x2F, 0x00});
+    deltas.push_back(0);
+    payload_lengths.push_back(0);
+    return stream;
+}
+
+TEST_CASE("Benchmark decoder on long delta times and payload lengths") {
+    std::vector<uint32_t> expected_deltas;
+    std::vector<uint32_t> expected_lengths;
+    std::vector<uint8_t> stream = make_long_vlq_stream(500000, expected_deltas, expected_lengths);
+    ByteSpan span(stream.data(), stream.size());
+
+    std::vector<uint32_t> deltas;
+    std::vector<uint32_t> lengths;
+    deltas.reserve(expected_deltas.size());
+    lengths.reserve(expected_lengths.size());
+    MidiDecoder::decode_track(span, [&](const MidiDecoder::Event &event)
+                              {
+                                  deltas.push_back(event.delta);
+                                  if (event.kind == MidiDecoder::EventKind::Meta)
+                                      lengths.push_back(event.payload_length);
+                                  return true; });
+    CHECK(deltas == expected_deltas);
+    CHECK(lengths == expected_lengths);
+
+    // best of a few alternating rounds, a single pass is mostly scheduler noise
+    double legacy_rate = 0.0;
+    double decoder_rate = 0.0;
+    for (int round = 0; round < 10; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t legacy_sum = 0;
+        legacy_switch_decode(span, [&](const MidiDecoder::Event &event)
+                             { legacy_sum += event.delta + event.payload_length; return true; });
+        auto legacy_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        uint64_t sum = 0;
+        MidiDecoder::decode_track(span, [&](const MidiDecoder::Event &event)
+                                  { sum += event.delta + event.payload_length; return true; });
+        auto decoder_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK_EQ(legacy_sum, sum);
+        legacy_rate = std::max(legacy_rate, expected_deltas.size() / legacy_time / 1e6);
+        decoder_rate = std::max(decoder_rate, expected_deltas.size() / decoder_time / 1e6);
+    }
+    MESSAGE("switch decoder: " << legacy_rate << " M events/s, decoder: " << decoder_rate << " M events/s");
+}
+
+TEST_CASE("Event store takes one arena block per track") {
+    std::vector<uint8_t> track = make_note_stream(100000, true);
+    ByteSpan span(track.data(), track.size());
+
+    ParseArena arena;
+    MidiEventStore store(&arena);
+    MidiDecoder::Validation validation = MidiDecoder::validate_track(span);
+    size_t num_events = validation.num_events;
+    CHECK_EQ(num_events, 100000 * 2 + 1);
+
+    arena.reserve(num_events * MidiEventStore::ROW_SIZE + 6 * alignof(uint32_t));
+    store.reserve(num_events);
+    MidiDecoder::decode_track(span, [&](const MidiDecoder::Event &event)
+                              { store.push_back(event); return true; });
+
+    CHECK_EQ(store.size(), num_events);
+    CHECK_EQ(arena.get_heap_allocation_count(), 1);
+    CHECK_EQ(store.get_note(2).get_note(), 37);
+    CHECK_EQ(store.get_meta(num_events - 1).get_type(), MidiDecoder::META_END_OF_TRACK);
+}
+
+TEST_CASE("Track filter drops events and keeps their time") {
+    const std::vector<uint8_t> track = {
+        0x00, 0xB0, 0x07, 0x64,                   // volume on channel 0
+        0x0A, 0x90, 0x3C, 0x40,                   // note on, channel 0
+        0x05, 0x91, 0x3C, 0x40,                   // note on, channel 1
+        0x05, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, // tempo
+        0x05, 0xFF, 0x01, 0x02, 'h', 'i',         // text
+        0x05, 0x80, 0x3C, 0x00,                   // note off, channel 0
+        0x00, 0xFF, 0x2F, 0x00};
+    ByteSpan span(track.data(), track.size());
+
+    MidiTrack decoded;
+    decoded.filter.categories = EventFilter::Notes;
+    decoded.filter.channels = 1 << 0;
+    decoded.decode(span);
+
+    // the notes of channel 0, the tempo change and the end of track
+    REQUIRE_EQ(decoded.events.size(), 4);
+    const uint32_t expected_ticks[] = {10, 20, 30, 30};
+    uint32_t tick = 0;
+    for (size_t i = 0; i < decoded.events.size(); i++)
+    {
+        tick += decoded.events.get_event(i).delta;
+        CHECK_EQ(tick, expected_ticks[i]);
+    }
+    CHECK_EQ(decoded.events.get_event(1).meta_type, EventFilter::META_SET_TEMPO);
+    CHECK(decoded.end_of_track);
+}
+
+TEST_CASE("Skipped bytes keep the time of the events after them") {
+    const std::vector<uint8_t> track = {
+        0x00, 0xFF, 0x03, 0x00, // empty track name, clears running status
+        0x10, 0x40,             // stray data byte
+        0x20, 0x90, 0x3C, 0x64, // note on
+        0x10, 0x80, 0x3C, 0x00, // note off
+        0x08, 0xF4,             // undefined status byte
+        0x08, 0x90, 0x3E, 0x64, // note on
+        0x00, 0xFF, 0x2F, 0x00};
+    ByteSpan span(track.data(), track.size());
+
+    MidiTrack decoded;
+    decoded.decode(span);
+
+    // both skipped events are reported, their delta times aren't lost
+    REQUIRE_EQ(decoded.events.size(), 5);
+    const uint32_t expected_ticks[] = {0, 48, 64, 80, 80};
+    uint32_t tick = 0;
+    for (size_t i = 0; i < decoded.events.size(); i++)
+    {
+        tick += decoded.events.get_event(i).delta;
+        CHECK_EQ(tick, expected_ticks[i]);
+    }
+    CHECK_EQ(decoded.diagnostics.get_category(ParseDiagnostics::StrayDataByte).count, 1);
+    CHECK_EQ(decoded.diagnostics.get_category(ParseDiagnostics::UnknownEvent).count, 1);
+
+    // the same length as counting every event, which is how tempo changes are placed on lazy tracks
+    uint32_t raw_ticks = 0;
+    MidiDecoder::decode_track(span, [&](const MidiDecoder::Event &event)
+                              { raw_ticks += event.delta; return true; });
+    CHECK_EQ(tick, raw_ticks);
+}
+
+TEST_CASE("Controller decimation stays within the tolerance and keeps the final values") {
+    std::vector<uint8_t> statuses;
+    std::vector<uint8_t> data1;
+    std::vector<uint8_t> data2;
+    std::vector<double> times;
+    const auto add = [&](double time, uint8_t status, uint8_t d1, uint8_t d2)
+    {
+        times.push_back(time);
+        statuses.push_back(status);
+        data1.push_back(d1);
+        data2.push_back(d2);
+    };
+
+    // a volume ramp on channel 0 with every value sent twice, a pitch bend wobble on channel 1,
+    // the sustain pedal and notes in between
+    add(0.0, 0x90, 60, 100);
+    add(0.0, 0xB0, 64, 127);
+    for (int i = 0; i < 128; i++)
+    {
+        add(i * 0.01, 0xB0, 7, static_cast<uint8_t>(i));
+        add(i * 0.01 + 0.005, 0xB0, 7, static_cast<uint8_t>(i));
+        const int bend = 8192 + static_cast<int>(4000.0 * std::sin(i * 0.1));
+        add(i * 0.01 + 0.005, 0xE1, static_cast<uint8_t>(bend & 0x7F), static_cast<uint8_t>(bend >> 7));
+    }
+    add(1.3, 0xB0, 64, 0);
+    add(1.3, 0x80, 60, 0);
+
+    ControllerDecimator::Settings settings;
+    settings.controller_tolerance = 4;
+    settings.pitch_bend_tolerance = 256;
+    ControllerDecimator::TrackEvents events = {statuses.data(), data1.data(), data2.data(), times.data(), statuses.size()};
+    std::vector<uint8_t> keep(statuses.size());
+    const size_t dropped = ControllerDecimator::decimate(events, settings, keep.data());
+
+    size_t num_dropped = 0;
+    int32_t held_volume = -1;
+    int32_t held_bend = -1;
+    for (size_t i = 0; i < statuses.size(); i++)
+    {
+        const bool is_volume = statuses[i] == 0xB0 && data1[i] == 7;
+        const bool is_bend = statuses[i] == 0xE1;
+        if (!is_volume && !is_bend)
+            CHECK(keep[i]);
+
+        num_dropped += keep[i] ? 0 : 1;
+        const int32_t value = is_bend ? (data1[i] | (data2[i] << 7)) : data2[i];
+        if (keep[i] && is_volume)
+            held_volume = value;
+        if (keep[i] && is_bend)
+            held_bend = value;
+
+        // what a receiver holds never strays further than the tolerance
+        if (is_volume)
+            CHECK_LE(std::abs(value - held_volume), settings.controller_tolerance);
+        if (is_bend)
+            CHECK_LE(std::abs(value - held_bend), settings.pitch_bend_tolerance);
+    }
+    CHECK_EQ(dropped, num_dropped);
+    CHECK_GT(dropped, 200);
+    CHECK_EQ(held_volume, 127);
+
+    // with no tolerance only the repeated values go
+    settings = ControllerDecimator::Settings();
+    CHECK_EQ(ControllerDecimator::decimate(events, settings, keep.data()), 128);
+}
+
+TEST_CASE("Diagnostics keep the first offsets of each category") {
+    ParseDiagnostics track_a;
+    ParseDiagnostics track_b;
+    for (int i = 0; i < ParseDiagnostics::MAX_OFFSETS + 4; i++)
+    {
+        track_a.report(ParseDiagnostics::UnknownEvent, i, 1);
+    }
+    track_b.report(ParseDiagnostics::UnknownEvent, 0, 1);
+    track_b.report(ParseDiagnostics::TruncatedTrack, 10, 5);
+
+    ParseDiagnostics file;
+    CHECK_FALSE(file.has_issues());
+    file.merge(track_a, 100);
+    file.merge(track_b, 200);
+
+    const ParseDiagnostics::CategoryInfo &unknown = file.get_category(ParseDiagnostics::UnknownEvent);
+    CHECK_EQ(unknown.count, ParseDiagnostics::MAX_OFFSETS + 5);
+    CHECK_EQ(unknown.offsets[0], 100);
+    CHECK_EQ(unknown.offsets[ParseDiagnostics::MAX_OFFSETS - 1], 100 + ParseDiagnostics::MAX_OFFSETS - 1);
+    CHECK_EQ(file.get_category(ParseDiagnostics::TruncatedTrack).offsets[0], 210);
+    CHECK_EQ(file.get_bytes_skipped(), ParseDiagnostics::MAX_OFFSETS + 4 + 1 + 5);
+    CHECK(file.has_issues());
+}
+
+TEST_CASE("Checked decoding stops at the first damaged event") {
+    std::vector<uint8_t> track = make_note_stream(1000, true);
+    // cut the end of track event and half of the last note off
+    track.resize(track.size() - 6);
+    ByteSpan span(track.data(), track.size());
+
+    std::vector<MidiDecoder::Event> events;
+    MidiDecoder::Validation validation = MidiDecoder::decode_checked(span, [&](const MidiDecoder::Event &event)
+                                                                      { events.push_back(event); return true; });
+    CHECK_EQ(validation.result, MidiDecoder::Result::Truncated);
+    CHECK_FALSE(validation.end_of_track);
+    CHECK_EQ(validation.num_events, 1000 * 2 - 1);
+    CHECK_EQ(events.size(), validation.num_events);
+    CHECK_EQ(validation.end_offset, events.back().offset + 2);
+
+    MidiDecoder::Validation check_only = MidiDecoder::validate_track(span);
+    CHECK_EQ(check_only.result, validation.result);
+    CHECK_EQ(check_only.end_offset, validation.end_offset);
+    CHECK_EQ(check_only.num_events, validation.num_events);
+
+    // the track keeps the same events, in a single arena block, and reports where the damage starts
+    MidiTrack decoded;
+    decoded.decode(span);
+    CHECK_EQ(decoded.events.size(), events.size());
+    CHECK_FALSE(decoded.end_of_track);
+    CHECK_EQ(decoded.arena->get_heap_allocation_count(), 1);
+    CHECK_EQ(decoded.diagnostics.get_category(ParseDiagnostics::TruncatedTrack).offsets[0], validation.end_offset);
+}
+
+TEST_CASE("Benchmark checked decoding into a track against a plain checked pass") {
+    std::vector<uint8_t> track = make_note_stream(500000, true);
+    ByteSpan span(track.data(), track.size());
+
+    // best of a few alternating rounds, a single pass is mostly scheduler noise
+    double checked_time = 1e9;
+    double validating_time = 1e9;
+    double track_time = 1e9;
+    size_t num_events = 0;
+    for (int round = 0; round < 5; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint32_t checked_sum = 0;
+        MidiDecoder::decode_track(span, [&](const MidiDecoder::Event &event)
+                                  { checked_sum += event.data1 + event.delta; return true; });
+        checked_time = std::min(checked_time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        start = std::chrono::steady_clock::now();
+        uint32_t validating_sum = 0;
+        MidiDecoder::Validation validation = MidiDecoder::decode_checked(span, [&](const MidiDecoder::Event &event)
+                                                                          { validating_sum += event.data1 + event.delta; return true; });
+        validating_time = std::min(validating_time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        CHECK_EQ(validation.result, MidiDecoder::Result::Ok);
+        CHECK_EQ(checked_sum, validating_sum);
+        num_events = validation.num_events;
+
+        // validation, diagnostics and the event store all in the same pass
+        start = std::chrono::steady_clock::now();
+        MidiTrack decoded;
+        decoded.decode(span);
+        track_time = std::min(track_time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        CHECK_EQ(decoded.events.size(), num_events);
+    }
+    const double count = static_cast<double>(num_events);
+    MESSAGE("checked: " << (count / checked_time / 1e6) << " M events/s, checked with validation: " << (count / validating_time / 1e6) << " M events/s, into a track: " << (count / track_time / 1e6) << " M events/s");
+}
+
+/// @brief appends a chunk header and its data to a midi file
+static void append_chunk(std::vector<uint8_t> &file, const char *id, const std::vector<uint8_t> &data)
+{
+    file.insert(file.end(), id, id + 4);
+    const uint32_t size = static_cast<uint32_t>(data.size());
+    file.insert(file.end(), {uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size)});
+    file.insert(file.end(), data.begin(), data.end());
+}
+
+/// @brief a format 1 file with a conductor track, a named track and an unnamed one
+static std::vector<uint8_t> make_probe_file()
+{
+    std::vector<uint8_t> file;
+    append_chunk(file, "MThd", {0x00, 0x01, 0x00, 0x03, 0x00, 0x60});
+    append_chunk(file, "MTrk", {
+                                   0x00, 0xFF, 0x03, 0x09, 'C', 'o', 'n', 'd', 'u', 'c', 't', 'o', 'r',
+                                   0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, // 500000 at tick 0
+                                   0x81, 0x40, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90, // 250000 at tick 192
+                                   0x81, 0x40, 0xFF, 0x2F, 0x00, // end at tick 384
+                               });
+    append_chunk(file, "MTrk", {
+                                   0x00, 0xFF, 0x03, 0x05, 'P', 'i', 'a', 'n', 'o',
+                                   0x00, 0x90, 0x3C, 0x64,
+                                   0x60, 0x3C, 0x00, // running status, zero velocity is a note off
+                                   0x00, 0x40, 0x64,
+                                   0x60, 0x80, 0x40, 0x00,
+                                   0x00, 0x91, 0x43, 0x50,
+                                   0x60, 0x81, 0x43, 0x00,
+                                   0x00, 0xFF, 0x2F, 0x00, // end at tick 288
+                               });
+    append_chunk(file, "MTrk", {
+                                   0x00, 0x99, 0x24, 0x7F,
+                                   0x30, 0x99, 0x26, 0x7F,
+                                   0x30, 0xFF, 0x2F, 0x00, // end at tick 96
+                               });
+    return file;
+}
+
+TEST_CASE("Probe summarizes a file without building events") {
+    const std::vector<uint8_t> file = make_probe_file();
+
+    MidiProbe::Summary summary;
+    REQUIRE(MidiProbe::probe(ByteSpan(file.data(), file.size()), summary));
+    CHECK_EQ(summary.header.format, 1);
+    CHECK_EQ(summary.header.num_tracks, 3);
+    CHECK_EQ(summary.header.division, 96);
+    REQUIRE_EQ(summary.track_names.size(), 3);
+    CHECK_EQ(std::string(reinterpret_cast<const char *>(summary.track_names[0].data), summary.track_names[0].size), "Conductor");
+    CHECK_EQ(std::string(reinterpret_cast<const char *>(summary.track_names[1].data), summary.track_names[1].size), "Piano");
+    CHECK(summary.track_names[2].is_empty());
+    CHECK_EQ(summary.note_count, 5);
+
+    REQUIRE_EQ(summary.tempo_changes.size(), 2);
+    CHECK_EQ(summary.tempo_changes[1].tick, 192);
+    CHECK_EQ(summary.tempo_changes[1].tempo, 250000);
+    CHECK_EQ(summary.length_ticks, 384);
+    // 192 ticks at 120 bpm and 192 ticks at 240 bpm
+    CHECK(std::fabs(summary.duration - 1.5) < 1e-9);
+}
+
+TEST_CASE("Probe summarizes a truncated file up to where it ends") {
+    const std::vector<uint8_t> file = make_probe_file();
+
+    // cut inside of the piano track, after its first two notes
+    const size_t piano_start = 14 + 8 + 33 + 8;
+    MidiProbe::Summary summary;
+    REQUIRE(MidiProbe::probe(ByteSpan(file.data(), piano_start + 22), summary));
+    CHECK_EQ(summary.header.num_tracks, 3);
+    CHECK_EQ(summary.track_names.size(), 2);
+    CHECK_EQ(summary.note_count, 2);
+    CHECK_EQ(summary.length_ticks, 384);
+    CHECK(std::fabs(summary.duration - 1.5) < 1e-9);
+
+    // a cut header is no midi file at all
+    CHECK_FALSE(MidiProbe::probe(ByteSpan(file.data(), 10), summary));
+    CHECK(summary.track_names.empty());
+}
+
+TEST_CASE("Probe skips events by the lengths the decoder reads") {
+    // every kind of event the skip loop has to step over, compared against a decoder pass
+    const std::vector<uint8_t> track = {
+        0x00, 0x90, 0x3C, 0x64,                   // note on
+        0x10, 0x3E, 0x64,                         // running status note on
+        0x00, 0xF8,                               // real time, keeps running status
+        0x00, 0x40, 0x00,                         // running status zero velocity note on
+        0x81, 0x80, 0x00, 0xF0, 0x03, 1, 2, 0xF7, // three byte delta, sysex cancels running status
+        0x00, 0x45,                               // a data byte without a status
+        0x00, 0xF2, 0x10, 0x20,                   // song position pointer
+        0x00, 0xF4,                               // undefined status
+        0x00, 0xC0, 0x05,                         // program change
+        0x00, 0xD0, 0x7F,                         // channel pressure
+        0x00, 0xFF, 0x01, 0x81, 0x00,             // text meta with a two byte length
+    };
+    std::vector<uint8_t> body = track;
+    body.insert(body.end(), 128, 'x');
+    body.insert(body.end(), {0x20, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90, // tempo change
+                             0x00, 0x91, 0x40, 0x50,
+                             0x08, 0xFF, 0x2F, 0x00,                   // end of track
+                             0x00, 0x90, 0x3C, 0x64});                 // after the end, ignored
+
+    int64_t notes = 0;
+    int64_t tick = 0;
+    const ByteSpan body_span(body.data(), body.size());
+    MidiDecoder::decode_track(body_span, [&](const MidiDecoder::Event &event)
+                              {
+                                  tick += event.delta;
+                                  if (event.kind == MidiDecoder::EventKind::Channel && (event.status >> 4) == 0x9 && event.data2 > 0)
+                                      notes++;
+                                  return true; });
+
+    std::vector<uint8_t> file;
+    append_chunk(file, "MThd", {0x00, 0x00, 0x00, 0x01, 0x00, 0x60});
+    append_chunk(file, "MTrk", body);
+    MidiProbe::Summary summary;
+    REQUIRE(MidiProbe::probe(ByteSpan(file.data(), file.size()), summary));
+    CHECK_EQ(notes, 3);
+    CHECK_EQ(summary.note_count, notes);
+    CHECK_EQ(summary.length_ticks, tick);
+    REQUIRE_EQ(summary.tempo_changes.size(), 1);
+    CHECK_EQ(summary.tempo_changes[0].tick, tick - 8);
+}
+
+/// @brief the Godot-free part of MidiResource::load_file, as a baseline for the probe:
+/// decode and copy every track into columns, index the ticks, build the tempo map and
+/// the event times, merge the timeline and pair the notes
+/// @return the number of paired notes
+static size_t load_without_godot(const ByteSpan &bytes)
+{
+    ByteSpan remaining = bytes;
+    MidiFile::Chunk chunk;
+    remaining = MidiFile::read_chunk(remaining, chunk);
+    MidiFile::FileHeader header;
+    MidiFile::read_header(chunk, header);
+
+    struct Columns
+    {
+        std::vector<int32_t> deltas;
+        std::vector<uint8_t> statuses;
+        std::vector<uint8_t> data1;
+        std::vector<uint8_t> data2;
+        std::vector<int32_t> ticks;
+        std::vector<double> times;
+    };
+    std::vector<Columns> tracks;
+    std::vector<TempoMap::Change> changes;
+    while (!remaining.is_empty())
+    {
+        remaining = MidiFile::read_chunk(remaining, chunk);
+        MidiTrack track;
+        track.decode(chunk.data);
+
+        // fill_columns and index_track
+        Columns columns;
+        const MidiEventStore &store = track.events;
+        int64_t tick = 0;
+        for (size_t i = 0; i < store.size(); i++)
+        {
+            const MidiDecoder::Event event = store.get_event(i);
+            if (event.kind == MidiDecoder::EventKind::Unknown)
+                continue;
+
+            tick += event.delta;
+            columns.deltas.push_back(static_cast<int32_t>(event.delta));
+            columns.statuses.push_back(event.status);
+            columns.data1.push_back(event.kind == MidiDecoder::EventKind::Meta ? event.meta_type : event.data1);
+            columns.data2.push_back(event.data2);
+            columns.ticks.push_back(static_cast<int32_t>(tick));
+            if (event.kind == MidiDecoder::EventKind::Meta && event.meta_type == MidiProbe::META_SET_TEMPO && event.payload_length >= 3)
+                changes.push_back({tick, static_cast<int32_t>(chunk.data.read_u24_be(event.payload_offset))});
+        }
+        tracks.push_back(std::move(columns));
+    }
+
+    // build_tempo_map, build_timeline and build_note_index
+    TempoMap tempo_map;
+    tempo_map.build(header.division, MidiProbe::DEFAULT_TEMPO, changes);
+    std::vector<MidiTimeline::TrackTicks> track_ticks;
+    size_t num_events = 0;
+    std::vector<NoteIndex::Note> notes;
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        Columns &columns = tracks[i];
+        columns.times.resize(columns.ticks.size());
+        tempo_map.ticks_to_seconds(columns.ticks.data(), columns.ticks.size(), columns.times.data());
+        track_ticks.push_back({columns.ticks.data(), columns.ticks.size()});
+        num_events += columns.ticks.size();
+        NoteIndex::pair_track({columns.statuses.data(), columns.data1.data(), columns.data2.data(), columns.times.data(), columns.statuses.size()}, static_cast<int32_t>(i), notes);
+    }
+    std::vector<int32_t> timeline_tracks(num_events);
+    std::vector<int32_t> timeline_events(num_events);
+    MidiTimeline::merge(track_ticks, timeline_tracks.data(), timeline_events.data());
+    NoteIndex note_index;
+    note_index.build(std::move(notes));
+    return note_index.get_notes().size();
+}
+
+TEST_CASE("Benchmark probe against a full load") {
+    // a large file, the probe only steps over the events the load builds columns, times and notes from
+    const int num_tracks = 16;
+    std::vector<uint8_t> file;
+    append_chunk(file, "MThd", {0x00, 0x01, 0x00, uint8_t(num_tracks), 0x01, 0xE0});
+    for (int i = 0; i < num_tracks; i++)
+    {
+        append_chunk(file, "MTrk", make_note_stream(50000, true));
+    }
+    const ByteSpan bytes(file.data(), file.size());
+
+    // best of a few alternating rounds, a single pass is mostly scheduler noise
+    double probe_time = 1e9;
+    double load_time = 1e9;
+    for (int round = 0; round < 5; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        MidiProbe::Summary summary;
+        REQUIRE(MidiProbe::probe(bytes, summary));
+        probe_time = std::min(probe_time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        CHECK_EQ(summary.note_count, int64_t(num_tracks) * 50000);
+
+        start = std::chrono::steady_clock::now();
+        const size_t num_notes = load_without_godot(bytes);
+        load_time = std::min(load_time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        CHECK_EQ(num_notes, size_t(num_tracks) * 50000);
+    }
+    MESSAGE("probe: " << (probe_time * 1e3) << " ms, load without Godot: " << (load_time * 1e3) << " ms, " << (load_time / probe_time) << "x");
+}
+
+TEST_CASE("Scheduler fires due events and seeks without firing") {
+    // one event per second
+    const double times[] = {0.0, 1.0, 2.0, 3.0};
+    const auto get_event_time = [&](size_t i)
+    {
+        return times[i];
+    };
+
+    std::vector<size_t> fired;
+    const auto fire = [&](size_t i)
+    {
+        fired.push_back(i);
+    };
+
+    MidiScheduler::TrackCursor cursor;
+    CHECK(MidiScheduler::advance(cursor, 4, 1.5, get_event_time, fire));
+    CHECK_EQ(fired.size(), 2);
+    CHECK_EQ(cursor.next_event, 2);
+
+    CHECK(MidiScheduler::advance(cursor, 4, 3.0, get_event_time, fire));
+    CHECK_EQ(fired.size(), 4);
+    CHECK_FALSE(MidiScheduler::advance(cursor, 4, 4.0, get_event_time, fire));
+
+    // seeking backwards starts over instead of keeping the old position
+    fired.clear();
+    MidiScheduler::seek(cursor, 4, 1.5, get_event_time);
+    CHECK(fired.empty());
+    CHECK_EQ(cursor.next_event, 2);
+}
+
+TEST_CASE("Scheduler seek lands where advancing from the start would") {
+    // several events per time, like chords and events on the same tick
+    std::vector<double> times;
+    for (int i = 0; i < 1000; i++)
+    {
+        times.push_back(static_cast<double>(i / 3) * 0.25);
+    }
+    const auto get_event_time = [&](size_t i)
+    {
+        return times[i];
+    };
+    const auto fire = [](size_t) {};
+
+    for (double song_time : {-1.0, 0.0, 0.1, 0.25, 10.0, 10.3, 83.0, 83.25, 1000.0})
+    {
+        MidiScheduler::TrackCursor advanced;
+        MidiScheduler::advance(advanced, times.size(), song_time, get_event_time, fire);
+
+        MidiScheduler::TrackCursor seeked;
+        seeked.next_event = 500;
+        MidiScheduler::seek(seeked, times.size(), song_time, get_event_time);
+        CHECK_EQ(seeked.next_event, advanced.next_event);
+    }
+
+    MidiScheduler::TrackCursor empty;
+    MidiScheduler::seek(empty, 0, 1.0, get_event_time);
+    CHECK_EQ(empty.next_event, 0);
+}
+
+TEST_CASE("Tempo map converts between ticks and seconds across tempo changes") {
+    // 96 ticks per quarter, 120 bpm, 60 bpm from tick 192, two changes on tick 384 where the last one wins
+    TempoMap tempo_map;
+    tempo_map.build(96, 500000, {{384, 250000}, {192, 1000000}, {384, 500000}});
+
+    REQUIRE_EQ(tempo_map.get_segments().size(), 3);
+    CHECK_EQ(tempo_map.get_segments()[2].tempo, 500000);
+
+    const auto near = [](double a, double b)
+    {
+        return std::abs(a - b) < 1e-9;
+    };
+    CHECK(near(tempo_map.tick_to_seconds(96), 0.5));
+    CHECK(near(tempo_map.tick_to_seconds(192), 1.0));
+    CHECK(near(tempo_map.tick_to_seconds(288), 2.0));
+    CHECK(near(tempo_map.tick_to_seconds(480), 3.5));
+
+    CHECK(near(tempo_map.seconds_to_tick(0.5), 96));
+    CHECK(near(tempo_map.seconds_to_tick(2.0), 288));
+    CHECK(near(tempo_map.seconds_to_tick(3.5), 480));
+
+    // the linear walk used for whole tracks matches the binary search
+    const int32_t ticks[] = {0, 96, 192, 288, 384, 480};
+    double seconds[6];
+    tempo_map.ticks_to_seconds(ticks, 6, seconds);
+    for (int i = 0; i < 6; i++)
+    {
+        CHECK(near(seconds[i], tempo_map.tick_to_seconds(ticks[i])));
+    }
+}
+
+TEST_CASE("Timeline merges tracks by tick and keeps track order on ties") {
+    const int32_t track0[] = {0, 10, 10, 30};
+    const int32_t track1[] = {5, 10};
+    const int32_t track2[] = {0};
+    std::vector<MidiTimeline::TrackTicks> tracks = {{track0, 4}, {track1, 2}, {track2, 1}, {nullptr, 0}};
+
+    int32_t out_tracks[7];
+    int32_t out_events[7];
+    MidiTimeline::merge(tracks, out_tracks, out_events);
+
+    const int32_t expected_tracks[] = {0, 2, 1, 0, 0, 1, 0};
+    const int32_t expected_events[] = {0, 0, 0, 1, 2, 1, 3};
+    for (int i = 0; i < 7; i++)
+    {
+        CHECK_EQ(out_tracks[i], expected_tracks[i]);
+        CHECK_EQ(out_events[i], expected_events[i]);
+    }
+}
+
+TEST_CASE("Timeline playback finishes when track by track playback would") {
+    // times in seconds, the last event of each track stands in for its end of track event
+    const int32_t track0[] = {0, 80, 100};
+    const int32_t track1[] = {30, 90};
+    std::vector<MidiTimeline::TrackTicks> tracks = {{track0, 3}, {track1, 2}};
+
+    int32_t merged_tracks[5];
+    int32_t merged_events[5];
+    MidiTimeline::merge(tracks, merged_tracks, merged_events);
+    const size_t finish = MidiTimeline::finish_position(tracks, merged_tracks, merged_events, 5);
+    CHECK_EQ(finish, 3);
+
+    // step both players the way MidiPlayer::process_delta does and note when each reports finished
+    std::vector<MidiScheduler::TrackCursor> track_cursors(tracks.size());
+    MidiScheduler::TrackCursor timeline_cursor;
+    int track_finished_at = -1;
+    int timeline_finished_at = -1;
+    for (int song_time = 0; song_time <= 120; song_time += 10)
+    {
+        bool has_more_events = false;
+        for (size_t i = 0; i < tracks.size(); i++)
+        {
+            const auto get_time = [&](size_t j)
+            {
+                return static_cast<double>(tracks[i].ticks[j]);
+            };
+            has_more_events |= MidiScheduler::advance(track_cursors[i], tracks[i].count, song_time, get_time, [](size_t) {});
+        }
+        if (!has_more_events && track_finished_at < 0)
+            track_finished_at = song_time;
+
+        const bool timeline_has_more = timeline_cursor.next_event < finish;
+        const auto get_timeline_time = [&](size_t j)
+        {
+            return static_cast<double>(tracks[merged_tracks[j]].ticks[merged_events[j]]);
+        };
+        MidiScheduler::advance(timeline_cursor, 5, song_time, get_timeline_time, [](size_t) {});
+        if (!timeline_has_more && timeline_finished_at < 0)
+            timeline_finished_at = song_time;
+    }
+
+    // one step after the last event that isn't the end of a track, not after the end of the whole song
+    CHECK_EQ(track_finished_at, 90);
+    CHECK_EQ(timeline_finished_at, track_finished_at);
+
+    // a song of single event tracks is finished right away
+    std::vector<MidiTimeline::TrackTicks> short_tracks = {{track0, 1}, {track1, 1}};
+    MidiTimeline::merge(short_tracks, merged_tracks, merged_events);
+    CHECK_EQ(MidiTimeline::finish_position(short_tracks, merged_tracks, merged_events, 2), 0);
+}
+
+TEST_CASE("Note index pairs notes and matches a linear scan") {
+    // note on 60, note on 64, zero velocity off 60, note off 64, a second 60 that is never closed
+    const uint8_t statuses[] = {0x90, 0x91, 0x90, 0x81, 0x90, 0xFF};
+    const uint8_t data1[] = {60, 64, 60, 64, 60, 0x2F};
+    const uint8_t data2[] = {100, 90, 0, 0, 80, 0};
+    const double times[] = {0.0, 0.5, 1.0, 2.0, 3.0, 4.0};
+
+    std::vector<NoteIndex::Note> notes;
+    NoteIndex::pair_track({statuses, data1, data2, times, 6}, 0, notes);
+    REQUIRE_EQ(notes.size(), 3);
+
+    NoteIndex index;
+    index.build(notes);
+    const std::vector<NoteIndex::Note> &sorted = index.get_notes();
+    CHECK_EQ(sorted[0].pitch, 60);
+    CHECK_EQ(sorted[0].end, 1.0);
+    CHECK_EQ(sorted[1].channel, 1);
+    CHECK_EQ(sorted[1].end, 2.0);
+    CHECK_EQ(sorted[2].end, 4.0);
+
+    std::vector<int32_t> found;
+    index.query_sounding(0.75, found);
+    CHECK_EQ(found.size(), 2);
+
+    // many random notes against a brute force scan
+    std::vector<NoteIndex::Note> random_notes;
+    uint32_t seed = 12345;
+    const auto next = [&]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    for (int i = 0; i < 2000; i++)
+    {
+        double start = (next() % 100000) / 100.0;
+        double length = (next() % 500) / 100.0;
+        random_notes.push_back({start, start + length, static_cast<uint8_t>(next() % 128), 100, 0, 0});
+    }
+    index.build(random_notes);
+
+    for (int q = 0; q < 200; q++)
+    {
+        double t0 = (next() % 100000) / 100.0;
+        double t1 = t0 + (next() % 300) / 100.0;
+        uint8_t pitch_lo = next() % 64;
+        uint8_t pitch_hi = pitch_lo + next() % 64;
+
+        found.clear();
+        index.query_range(t0, t1, pitch_lo, pitch_hi, found);
+        size_t expected = 0;
+        for (const NoteIndex::Note &note : index.get_notes())
+        {
+            if (note.start <= t1 && note.end >= t0 && note.pitch >= pitch_lo && note.pitch <= pitch_hi)
+                expected++;
+        }
+        CHECK_EQ(found.size(), expected);
+
+        found.clear();
+        index.query_sounding(t0, found);
+        expected = 0;
+        for (const NoteIndex::Note &note : index.get_notes())
+        {
+            if (note.start <= t0 && note.end > t0)
+                expected++;
+        }
+        CHECK_EQ(found.size(), expected);
+    }
+}
+
+TEST_CASE("Tempo map and note index take back what they built") {
+    // what load_binary does with the segments and notes save_file wrote
+    TempoMap built;
+    built.build(96, 500000, {{192, 1000000}, {384, 250000}});
+    TempoMap assigned;
+    REQUIRE(assigned.assign(built.get_segments()));
+    CHECK_EQ(assigned.tick_to_seconds(480), built.tick_to_seconds(480));
+    CHECK_EQ(assigned.seconds_to_tick(2.5), built.seconds_to_tick(2.5));
+
+    // damaged segments are refused and leave the map as it was
+    std::vector<TempoMap::Segment> unordered = built.get_segments();
+    std::swap(unordered[1], unordered[2]);
+    CHECK_FALSE(assigned.assign(unordered));
+    CHECK_FALSE(assigned.assign({}));
+    CHECK_EQ(assigned.get_segments().size(), 3);
+
+    NoteIndex index;
+    index.build({{3.0, 4.0, 62, 100, 0, 0}, {0.0, 5.0, 60, 100, 0, 1}, {1.0, 1.5, 64, 100, 0, 0}});
+    NoteIndex copy;
+    REQUIRE(copy.assign(index.get_notes()));
+
+    std::vector<int32_t> expected;
+    std::vector<int32_t> found;
+    index.query_range(1.2, 3.5, 0, 127, expected);
+    copy.query_range(1.2, 3.5, 0, 127, found);
+    CHECK(found == expected);
+    CHECK_EQ(found.size(), 3);
+
+    std::vector<NoteIndex::Note> unsorted = index.get_notes();
+    std::swap(unsorted[0], unsorted[2]);
+    CHECK_FALSE(copy.assign(unsorted));
+    CHECK_EQ(copy.get_notes().size(), 3);
+}